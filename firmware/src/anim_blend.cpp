@@ -0,0 +1,148 @@
+#include "anim_blend.h"
+
+#include <string.h>
+
+static const char* const MODE_NAMES[ANIM_BLEND_MODE_COUNT] = {"none", "dither", "morph"};
+
+// 4x4 Bayer thresholds, row by row
+static const uint8_t BAYER[4][4] = {
+  {0, 8, 2, 10},
+  {12, 4, 14, 6},
+  {3, 11, 1, 9},
+  {15, 7, 13, 5},
+};
+
+const char* animBlendName(uint8_t mode) {
+  return mode < ANIM_BLEND_MODE_COUNT ? MODE_NAMES[mode] : "unknown";
+}
+
+uint8_t animBlendFind(const char* name) {
+  for (uint8_t i = 0; i < ANIM_BLEND_MODE_COUNT; i++) {
+    if (strcmp(MODE_NAMES[i], name) == 0) {
+      return i;
+    }
+  }
+  return ANIM_BLEND_MODE_COUNT;
+}
+
+// Rows of column x taken from `to` at this level, repeated every 4 rows
+static inline uint64_t ditherColumn(int x, uint8_t level) {
+  uint64_t rows = 0;
+  for (int y = 0; y < 4; y++) {
+    if (BAYER[y][x & 3] < level) {
+      rows |= 1ULL << y;
+    }
+  }
+  return rows * 0x1111111111111111ULL;
+}
+
+// Byte k of a word is column 4n + k, so each byte is that column's pattern
+uint32_t animDitherMask(uint8_t level) {
+  uint32_t mask = 0;
+  for (int x = 0; x < 4; x++) {
+    mask |= (uint32_t)(uint8_t)ditherColumn(x, level) << (x * 8);
+  }
+  return mask;
+}
+
+static void dither(const uint8_t* from, const uint8_t* to, uint8_t* out, uint8_t level) {
+  uint32_t mask = animDitherMask(level);
+
+  if (((uintptr_t)from | (uintptr_t)to | (uintptr_t)out) & 3) {
+    for (int i = 0; i < ANIM_FRAME_BYTES; i++) {
+      uint8_t m = mask >> ((i & 3) * 8);
+      out[i] = (from[i] & ~m) | (to[i] & m);
+    }
+    return;
+  }
+
+  const uint32_t* a = (const uint32_t*)from;
+  const uint32_t* b = (const uint32_t*)to;
+  uint32_t* o = (uint32_t*)out;
+  for (int i = 0; i < ANIM_FRAME_BYTES / 4; i++) {
+    o[i] = (a[i] & ~mask) | (b[i] & mask);
+  }
+}
+
+static inline uint64_t readColumn(const uint8_t* frame, int x) {
+  uint64_t column = 0;
+  for (int page = 0; page < ANIM_FRAME_HEIGHT / 8; page++) {
+    column |= (uint64_t)frame[page * ANIM_FRAME_WIDTH + x] << (page * 8);
+  }
+  return column;
+}
+
+static inline void writeColumn(uint8_t* frame, int x, uint64_t column) {
+  for (int page = 0; page < ANIM_FRAME_HEIGHT / 8; page++) {
+    frame[page * ANIM_FRAME_WIDTH + x] = (uint8_t)(column >> (page * 8));
+  }
+}
+
+// Bits y0..y1 of a column
+static inline uint64_t span(int y0, int y1) {
+  return (~0ULL << y0) & (~0ULL >> (63 - y1));
+}
+
+// Ends of the column's only run of set pixels, false if it has none or several
+static inline bool singleRun(uint64_t column, int* top, int* bottom) {
+  if (!column) {
+    return false;
+  }
+  *top = __builtin_ctzll(column);
+  uint64_t shifted = column >> *top;
+  if (shifted & (shifted + 1)) {
+    return false;
+  }
+  *bottom = 63 - __builtin_clzll(column);
+  return true;
+}
+
+static uint64_t morphColumn(uint64_t from, uint64_t to, uint8_t level, uint64_t mask) {
+  int fromTop, fromBottom, toTop, toBottom;
+  bool fromRun = singleRun(from, &fromTop, &fromBottom);
+  bool toRun = singleRun(to, &toTop, &toBottom);
+
+  // A run appearing or disappearing grows from / shrinks to its middle
+  if (fromRun && !to) {
+    toTop = toBottom = (fromTop + fromBottom) / 2;
+    toRun = true;
+  } else if (toRun && !from) {
+    fromTop = fromBottom = (toTop + toBottom) / 2;
+    fromRun = true;
+  }
+  if (!fromRun || !toRun) {
+    return (from & to) | ((from ^ to) & mask);
+  }
+
+  int top = fromTop + ((toTop - fromTop) * level + ANIM_BLEND_LEVELS / 2) / ANIM_BLEND_LEVELS;
+  int bottom = fromBottom + ((toBottom - fromBottom) * level + ANIM_BLEND_LEVELS / 2) / ANIM_BLEND_LEVELS;
+  return span(top, bottom);
+}
+
+void animBlend(const uint8_t* from, const uint8_t* to, uint8_t* out, uint8_t mode, uint8_t level) {
+  if (level == 0 || level >= ANIM_BLEND_LEVELS || mode == ANIM_BLEND_NONE) {
+    const uint8_t* source = level * 2 < ANIM_BLEND_LEVELS ? from : to;
+    if (source != out) {
+      memcpy(out, source, ANIM_FRAME_BYTES);
+    }
+    return;
+  }
+  if (mode != ANIM_BLEND_MORPH) {
+    dither(from, to, out, level);
+    return;
+  }
+
+  uint64_t masks[4];
+  for (int x = 0; x < 4; x++) {
+    masks[x] = ditherColumn(x, level);
+  }
+  for (int x = 0; x < ANIM_FRAME_WIDTH; x++) {
+    uint64_t a = readColumn(from, x);
+    uint64_t b = readColumn(to, x);
+    if (a != b) {
+      writeColumn(out, x, morphColumn(a, b, level, masks[x & 3]));
+    } else if (out != from) {
+      writeColumn(out, x, a);
+    }
+  }
+}
@@ -0,0 +1,40 @@
+// Blending between two page-format frames
+// Synthesizes the frames between two stored ones at runtime, for smoother
+// playback (anim_player.h) and transitions without stored frames
+// (transition.h):
+//   DITHER  ordered 4x4 Bayer crossfade, pixels switch over as the level
+//           rises. The pattern repeats every 4 columns and 4 rows, so one
+//           32 bit mask covers every aligned word of a frame.
+//   MORPH   works on one 64 pixel column at a time, gathered from the 8
+//           pages. Columns holding a single run (eye blobs) move their run's
+//           ends towards the other frame's, so shapes grow and shrink
+//           instead of fading; every other column falls back to DITHER.
+
+#ifndef ANIM_BLEND_H
+#define ANIM_BLEND_H
+
+#include <stdint.h>
+
+#include "anim_pack.h"
+
+// Levels from `from` (0) to `to` (ANIM_BLEND_LEVELS)
+#define ANIM_BLEND_LEVELS 16
+
+enum AnimBlendMode : uint8_t {
+  ANIM_BLEND_NONE = 0,  // Cut at the halfway level
+  ANIM_BLEND_DITHER,
+  ANIM_BLEND_MORPH,
+  ANIM_BLEND_MODE_COUNT
+};
+
+const char* animBlendName(uint8_t mode);
+// ANIM_BLEND_MODE_COUNT for unknown names
+uint8_t animBlendFind(const char* name);
+
+// Pixels taken from `to` at this level, for each aligned 32 bit word
+uint32_t animDitherMask(uint8_t level);
+
+// `out` may be `from` or `to`
+void animBlend(const uint8_t* from, const uint8_t* to, uint8_t* out, uint8_t mode, uint8_t level);
+
+#endif
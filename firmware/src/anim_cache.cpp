@@ -0,0 +1,209 @@
+#include "anim_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "host/host_time.h"
+#endif
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+static uint8_t* allocFrame() {
+#ifdef ESP_PLATFORM
+  // Internal DRAM only - PSRAM would be slower than decoding from flash
+  return (uint8_t*)heap_caps_malloc(ANIM_FRAME_BYTES, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+  return (uint8_t*)malloc(ANIM_FRAME_BYTES);
+#endif
+}
+
+void AnimFrameCache::begin(size_t budgetBytes) {
+  clear();
+  size_t frames = budgetBytes / ANIM_FRAME_BYTES;
+  capacity = frames > ANIM_CACHE_MAX_ENTRIES ? ANIM_CACHE_MAX_ENTRIES : frames;
+  pinCount = 0;
+
+  // What a hit costs, frames that decode faster than this aren't worth a slot
+  uint8_t* scratch = allocFrame();
+  uint8_t* target = allocFrame();
+  copyCostUs = 0;
+  if (scratch && target) {
+    memset(scratch, 0, ANIM_FRAME_BYTES);
+    unsigned long start = micros();
+    for (int i = 0; i < 8; i++) {
+      memcpy(target, scratch, ANIM_FRAME_BYTES);
+      __asm__ __volatile__("" ::: "memory");
+    }
+    copyCostUs = (micros() - start + 7) / 8;
+  }
+  free(scratch);
+  free(target);
+}
+
+void AnimFrameCache::clear() {
+  for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+    if (slots[i].data) {
+      release(i);
+    }
+  }
+}
+
+void AnimFrameCache::release(int slot) {
+  free(slots[slot].data);
+  slots[slot].data = nullptr;
+  slots[slot].pinned = false;
+  used--;
+}
+
+int AnimFrameCache::find(uint16_t index) const {
+  for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+    if (slots[i].data && slots[i].frame == index) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool AnimFrameCache::isPinned(uint16_t index) const {
+  for (uint16_t i = 0; i < pinCount; i++) {
+    if (pins[i] == index) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint16_t AnimFrameCache::pinnedEntries() const {
+  uint16_t count = 0;
+  for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+    if (slots[i].data && slots[i].pinned) {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Least recently used entry, pinned ones only when nothing else is left
+int AnimFrameCache::victim(bool allowPinned) const {
+  int oldest = -1;
+  for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+    if (!slots[i].data || (slots[i].pinned && !allowPinned)) {
+      continue;
+    }
+    if (oldest < 0 || slots[i].lastUse < slots[oldest].lastUse) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+bool AnimFrameCache::heapLow() const {
+#ifdef ESP_PLATFORM
+  return heap_caps_get_free_size(MALLOC_CAP_INTERNAL) < ANIM_CACHE_MIN_FREE_HEAP;
+#else
+  return false;
+#endif
+}
+
+void AnimFrameCache::shrinkIfLow() {
+  while (used > 0 && heapLow()) {
+    int slot = victim(false);
+    if (slot < 0) {
+      slot = victim(true);
+    }
+    release(slot);
+    perf.shrinks++;
+  }
+}
+
+bool AnimFrameCache::fetch(uint16_t index, uint8_t* frameBuffer) {
+  // Heap can run low without any stores, e.g. while serving a request
+  if ((useCounter & 15) == 0) {
+    shrinkIfLow();
+  }
+  useCounter++;
+
+  int slot = find(index);
+  if (slot < 0) {
+    perf.misses++;
+    return false;
+  }
+
+  memcpy(frameBuffer, slots[slot].data, ANIM_FRAME_BYTES);
+  slots[slot].lastUse = useCounter;
+  perf.hits++;
+  return true;
+}
+
+void AnimFrameCache::store(uint16_t index, const uint8_t* frameBuffer, uint32_t decodeUs) {
+  bool pinned = isPinned(index);
+  if (capacity == 0 || (!pinned && decodeUs <= copyCostUs) || find(index) >= 0) {
+    return;
+  }
+
+  shrinkIfLow();
+  if (heapLow()) {
+    return;
+  }
+
+  int slot = -1;
+  if (used < capacity) {
+    for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+      if (!slots[i].data) {
+        slot = i;
+        break;
+      }
+    }
+    slots[slot].data = allocFrame();
+    if (!slots[slot].data) {
+      return;
+    }
+    used++;
+  } else {
+    // Full - a pinned frame may push out another pinned one, nothing else may
+    slot = victim(false);
+    if (slot < 0 && pinned) {
+      slot = victim(true);
+    }
+    if (slot < 0) {
+      return;
+    }
+    perf.evictions++;
+  }
+
+  memcpy(slots[slot].data, frameBuffer, ANIM_FRAME_BYTES);
+  slots[slot].frame = index;
+  slots[slot].pinned = pinned;
+  slots[slot].lastUse = useCounter;
+}
+
+void AnimFrameCache::pinClip(const AnimPack* pack, const AnimClipEntry* clip) {
+  pinCount = 0;
+  for (uint16_t s = 0; clip && s < clip->segmentCount; s++) {
+    const AnimSegment* segment = pack->segment(clip->firstSegment + s);
+    for (uint16_t f = 0; f < segment->frameCount; f++) {
+      uint16_t index = segment->firstFrame + f;
+      const AnimFrameHeader* frame = pack->frame(index);
+      // Keep half the cache for everything else
+      if ((frame->flags & ANIM_FRAME_KEY) && frame->codec != ANIM_CODEC_HOLD &&
+          pinCount < capacity / 2 && !isPinned(index)) {
+        pins[pinCount++] = index;
+      }
+    }
+  }
+
+  for (int i = 0; i < ANIM_CACHE_MAX_ENTRIES; i++) {
+    if (slots[i].data) {
+      slots[i].pinned = isPinned(slots[i].frame);
+    }
+  }
+}
+
+void AnimFrameCache::resetStats() {
+  memset(&perf, 0, sizeof(perf));
+}
@@ -0,0 +1,81 @@
+// LRU cache of decoded frames in internal DRAM
+// Keyed by stored frame index: a frame always decodes to the same image,
+// whichever clip or direction reaches it, so a hit turns the decode into a
+// 1 KB copy. Only frames that took longer to decode than such a copy are
+// admitted, plus the keyframes of the clip being played, which are pinned.
+// Entries are allocated one by one and handed back when free heap runs low.
+
+#ifndef ANIM_CACHE_H
+#define ANIM_CACHE_H
+
+#include "anim_pack.h"
+
+// Default byte budget, override with -DANIM_CACHE_BYTES=...
+#ifndef ANIM_CACHE_BYTES
+#define ANIM_CACHE_BYTES (32 * 1024)
+#endif
+
+// Below this much free internal heap the cache frees entries
+#ifndef ANIM_CACHE_MIN_FREE_HEAP
+#define ANIM_CACHE_MIN_FREE_HEAP (48 * 1024)
+#endif
+
+#define ANIM_CACHE_MAX_ENTRIES 64
+
+struct AnimCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;
+  uint32_t shrinks;   // Entries freed because of low heap
+};
+
+class AnimFrameCache {
+public:
+  void begin(size_t budgetBytes);
+  void clear();
+
+  // Copies a cached frame into frameBuffer
+  bool fetch(uint16_t index, uint8_t* frameBuffer);
+  // Offers a freshly decoded frame, kept if it is pinned or decodeUs beats a copy
+  void store(uint16_t index, const uint8_t* frameBuffer, uint32_t decodeUs);
+
+  // Pins the keyframes of a clip (and unpins the previous clip's)
+  void pinClip(const AnimPack* pack, const AnimClipEntry* clip);
+
+  size_t budget() const { return capacity * ANIM_FRAME_BYTES; }
+  size_t bytes() const { return used * ANIM_FRAME_BYTES; }
+  uint16_t entries() const { return used; }
+  uint16_t pinnedEntries() const;
+  uint32_t copyUs() const { return copyCostUs; }
+
+  const AnimCacheStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  struct Entry {
+    uint8_t* data;
+    uint32_t lastUse;
+    uint16_t frame;
+    bool pinned;
+  };
+
+  bool isPinned(uint16_t index) const;
+  int find(uint16_t index) const;
+  int victim(bool allowPinned) const;
+  void release(int slot);
+  bool heapLow() const;
+  void shrinkIfLow();
+
+  Entry slots[ANIM_CACHE_MAX_ENTRIES] = {};
+  uint16_t capacity = 0;
+  uint16_t used = 0;
+  uint32_t useCounter = 0;
+  uint32_t copyCostUs = 0;
+
+  uint16_t pins[ANIM_CACHE_MAX_ENTRIES];
+  uint16_t pinCount = 0;
+
+  AnimCacheStats perf = {};
+};
+
+#endif
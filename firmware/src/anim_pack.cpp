@@ -0,0 +1,205 @@
+#include "anim_pack.h"
+
+#include <string.h>
+
+static const char* const CODEC_NAMES[ANIM_CODEC_COUNT] = {"hold", "raw", "lz", "xor"};
+
+const char* animCodecName(uint8_t codec) {
+  return codec < ANIM_CODEC_COUNT ? CODEC_NAMES[codec] : "unknown";
+}
+
+bool AnimPack::begin(const uint8_t* packData, size_t packSize) {
+  header = nullptr;
+  data = packData;
+  dataSize = packSize;
+
+  if (!packData || packSize < sizeof(AnimPackHeader)) {
+    return false;
+  }
+
+  const AnimPackHeader* h = (const AnimPackHeader*)packData;
+  if (memcmp(h->magic, "TABP", 4) != 0 || h->version != ANIM_PACK_VERSION) {
+    return false;
+  }
+  if (h->totalSize > packSize) {
+    return false;
+  }
+
+  size_t clipTableEnd = h->clipTableOffset + (size_t)h->clipCount * sizeof(AnimClipEntry);
+  size_t segmentTableEnd = h->segmentTableOffset + (size_t)h->segmentCount * sizeof(AnimSegment);
+  size_t frameIndexEnd = h->frameIndexOffset + (size_t)h->frameCount * sizeof(uint32_t);
+  if (clipTableEnd > h->totalSize || segmentTableEnd > h->totalSize || frameIndexEnd > h->totalSize ||
+      (h->clipTableOffset & 3) || (h->segmentTableOffset & 1) || (h->frameIndexOffset & 3)) {
+    return false;
+  }
+
+  const AnimClipEntry* clipTable = (const AnimClipEntry*)(packData + h->clipTableOffset);
+  const AnimSegment* segmentTable = (const AnimSegment*)(packData + h->segmentTableOffset);
+  const uint32_t* offsets = (const uint32_t*)(packData + h->frameIndexOffset);
+
+  for (uint16_t i = 0; i < h->clipCount; i++) {
+    const AnimClipEntry& c = clipTable[i];
+    if (c.segmentCount == 0 || c.loopSegment >= c.segmentCount ||
+        (uint32_t)c.firstSegment + c.segmentCount > h->segmentCount || c.mode > ANIM_PLAY_PINGPONG) {
+      return false;
+    }
+  }
+
+  for (uint16_t i = 0; i < h->segmentCount; i++) {
+    const AnimSegment& s = segmentTable[i];
+    if (s.frameCount == 0 || (uint32_t)s.firstFrame + s.frameCount > h->frameCount) {
+      return false;
+    }
+  }
+
+  for (uint16_t i = 0; i < h->frameCount; i++) {
+    uint32_t offset = offsets[i];
+    if ((offset & 3) || offset + sizeof(AnimFrameHeader) > h->totalSize) {
+      return false;
+    }
+    const AnimFrameHeader* f = (const AnimFrameHeader*)(packData + offset);
+    if (f->codec >= ANIM_CODEC_COUNT || offset + sizeof(AnimFrameHeader) + f->payloadSize > h->totalSize) {
+      return false;
+    }
+  }
+
+  clips = clipTable;
+  segments = segmentTable;
+  frameOffsets = offsets;
+  header = h;
+  return true;
+}
+
+int AnimPack::findClip(const char* name) const {
+  for (uint16_t i = 0; i < clipCount(); i++) {
+    if (strncmp(clips[i].name, name, ANIM_CLIP_NAME_LEN) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const AnimClipEntry* AnimPack::clip(int index) const {
+  if (index < 0 || index >= clipCount()) {
+    return nullptr;
+  }
+  return &clips[index];
+}
+
+const AnimSegment* AnimPack::segment(uint16_t index) const {
+  if (index >= segmentCount()) {
+    return nullptr;
+  }
+  return &segments[index];
+}
+
+const AnimFrameHeader* AnimPack::frame(uint16_t index) const {
+  if (index >= frameCount()) {
+    return nullptr;
+  }
+  return (const AnimFrameHeader*)(data + frameOffsets[index]);
+}
+
+static bool decodeLz(const uint8_t* in, uint16_t size, uint8_t* out) {
+  const uint8_t* end = in + size;
+  uint16_t pos = 0;
+
+  while (in < end && pos < ANIM_FRAME_BYTES) {
+    uint8_t flags = *in++;
+    for (uint8_t bit = 0; bit < 8 && in < end && pos < ANIM_FRAME_BYTES; bit++) {
+      if (!(flags & (1 << bit))) {
+        out[pos++] = *in++;
+        continue;
+      }
+
+      if (end - in < 2) {
+        return false;
+      }
+      uint16_t distance = in[0] | ((in[1] & 0x0F) << 8);
+      uint16_t length = (in[1] >> 4) + 3;
+      in += 2;
+      if (length == 18) {
+        if (in >= end) {
+          return false;
+        }
+        length += *in++;
+      }
+      if (distance == 0 || distance > pos || pos + length > ANIM_FRAME_BYTES) {
+        return false;
+      }
+
+      // Byte copy on purpose - overlapping matches encode runs
+      const uint8_t* src = out + pos - distance;
+      while (length--) {
+        out[pos++] = *src++;
+      }
+    }
+  }
+
+  return pos == ANIM_FRAME_BYTES && in == end;
+}
+
+static bool decodeXor(const uint8_t* in, uint16_t size, uint8_t* frame) {
+  const uint8_t* end = in + size;
+  uint16_t pos = 0;
+
+  while (end - in >= 2) {
+    pos += in[0];
+    uint8_t count = in[1];
+    in += 2;
+    if (pos + count > ANIM_FRAME_BYTES || end - in < count) {
+      return false;
+    }
+    while (count--) {
+      frame[pos++] ^= *in++;
+    }
+  }
+
+  return in == end;
+}
+
+bool AnimPack::decodeFrame(uint16_t index, uint8_t* frameBuffer) const {
+  const AnimFrameHeader* f = frame(index);
+  if (!f) {
+    return false;
+  }
+
+  const uint8_t* payload = (const uint8_t*)(f + 1);
+  switch (f->codec) {
+    case ANIM_CODEC_HOLD:
+      return true;
+    case ANIM_CODEC_RAW:
+      if (f->payloadSize != ANIM_FRAME_BYTES) {
+        return false;
+      }
+      memcpy(frameBuffer, payload, ANIM_FRAME_BYTES);
+      return true;
+    case ANIM_CODEC_LZ:
+      return decodeLz(payload, f->payloadSize, frameBuffer);
+    case ANIM_CODEC_XOR:
+      return decodeXor(payload, f->payloadSize, frameBuffer);
+    default:
+      return false;
+  }
+}
+
+bool AnimPack::stepTo(uint16_t index, bool backward, uint8_t* frameBuffer, uint16_t* applied) const {
+  const AnimFrameHeader* f = frame(index);
+  if (!f) {
+    return false;
+  }
+
+  uint16_t source = index;
+  if (backward && !(f->flags & ANIM_FRAME_KEY)) {
+    const AnimFrameHeader* following = frame(index + 1);
+    if (!following || (following->flags & ANIM_FRAME_KEY)) {
+      return false;
+    }
+    source = index + 1;
+  }
+
+  if (applied) {
+    *applied = source;
+  }
+  return decodeFrame(source, frameBuffer);
+}
@@ -0,0 +1,130 @@
+// Packed animation assets ("TABP" blob)
+// Written by tools/animpack.py, frames are stored in the U8g2/SH1106 page
+// layout (8 pages x 128 columns, LSB = top pixel) so a decoded frame can be
+// copied straight into the display buffer.
+
+#ifndef ANIM_PACK_H
+#define ANIM_PACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ANIM_FRAME_WIDTH 128
+#define ANIM_FRAME_HEIGHT 64
+#define ANIM_FRAME_BYTES 1024
+
+#define ANIM_PACK_VERSION 2
+#define ANIM_CLIP_NAME_LEN 16
+
+// Clip flags
+#define ANIM_CLIP_LOOP 0x01
+#define ANIM_CLIP_DITHER 0x02  // Show a dithered in-between frame (anim_blend.h)
+#define ANIM_CLIP_MORPH 0x04   // Show a morphed in-between frame
+
+// Segment flags
+#define ANIM_SEGMENT_REVERSE 0x01  // Show the frames last to first
+
+// Frame flags
+#define ANIM_FRAME_KEY 0x01  // Decodes without the previous frame
+
+// Per-frame codec, chosen by the pack compiler
+enum AnimCodec : uint8_t {
+  ANIM_CODEC_HOLD = 0,  // Same as previous frame, no payload
+  ANIM_CODEC_RAW = 1,   // 1024 bytes page data
+  ANIM_CODEC_LZ = 2,    // LZSS, 12 bit distance
+  ANIM_CODEC_XOR = 3,   // Sparse XOR delta against previous frame
+  ANIM_CODEC_COUNT
+};
+
+// How a clip's loop body is played
+enum AnimPlayMode : uint8_t {
+  ANIM_PLAY_FORWARD = 0,
+  ANIM_PLAY_REVERSE = 1,
+  ANIM_PLAY_PINGPONG = 2  // Forward then back, end frames not repeated
+};
+
+struct AnimPackHeader {
+  char magic[4];            // "TABP"
+  uint16_t version;
+  uint16_t clipCount;
+  uint16_t frameCount;
+  uint16_t segmentCount;
+  uint16_t decodeBudgetUs;  // Budget the compiler selected codecs against
+  uint16_t reserved;
+  uint32_t clipTableOffset;
+  uint32_t segmentTableOffset;
+  uint32_t frameIndexOffset;
+  uint32_t totalSize;
+};
+
+// A clip is a run of segments: [0, loopSegment) plays once as an intro,
+// [loopSegment, segmentCount) is the body played according to mode
+struct AnimClipEntry {
+  char name[ANIM_CLIP_NAME_LEN];
+  uint16_t firstSegment;
+  uint16_t segmentCount;
+  uint16_t frameDelayMs;
+  uint8_t flags;
+  uint8_t mode;
+  uint16_t loopSegment;
+  uint16_t reserved;
+};
+
+// A range of stored frames, shared between clips and playable backwards
+struct AnimSegment {
+  uint16_t firstFrame;
+  uint16_t frameCount;
+  uint8_t flags;
+  uint8_t reserved;
+};
+
+struct AnimFrameHeader {
+  uint8_t codec;
+  uint8_t flags;
+  uint16_t payloadSize;
+};
+
+static_assert(sizeof(AnimPackHeader) == 32, "pack header layout");
+static_assert(sizeof(AnimClipEntry) == 28, "clip entry layout");
+static_assert(sizeof(AnimSegment) == 6, "segment layout");
+static_assert(sizeof(AnimFrameHeader) == 4, "frame header layout");
+
+const char* animCodecName(uint8_t codec);
+
+class AnimPack {
+public:
+  // Validates the header and tables, data must stay valid while in use
+  bool begin(const uint8_t* data, size_t size);
+
+  bool isValid() const { return header != nullptr; }
+  uint16_t clipCount() const { return header ? header->clipCount : 0; }
+  uint16_t frameCount() const { return header ? header->frameCount : 0; }
+  uint16_t segmentCount() const { return header ? header->segmentCount : 0; }
+  uint16_t decodeBudgetUs() const { return header ? header->decodeBudgetUs : 0; }
+  size_t size() const { return dataSize; }
+
+  int findClip(const char* name) const;
+  const AnimClipEntry* clip(int index) const;
+  const AnimSegment* segment(uint16_t index) const;
+  const AnimFrameHeader* frame(uint16_t index) const;
+
+  // Applies frame `index` to `frameBuffer`, which must hold the image the
+  // frame was encoded against unless the frame is a keyframe
+  bool decodeFrame(uint16_t index, uint8_t* frameBuffer) const;
+
+  // Moves `frameBuffer` to frame `index`. Going backwards decodes keyframes
+  // directly and otherwise undoes the following frame - XOR and hold deltas
+  // are their own inverse, so reverse playback costs the same as forward.
+  // Returns the frame whose payload was used through `applied`.
+  bool stepTo(uint16_t index, bool backward, uint8_t* frameBuffer, uint16_t* applied = nullptr) const;
+
+private:
+  const uint8_t* data = nullptr;
+  size_t dataSize = 0;
+  const AnimPackHeader* header = nullptr;
+  const AnimClipEntry* clips = nullptr;
+  const AnimSegment* segments = nullptr;
+  const uint32_t* frameOffsets = nullptr;
+};
+
+#endif
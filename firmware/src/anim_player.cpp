@@ -0,0 +1,279 @@
+#include "anim_player.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "host/host_time.h"
+#endif
+#include <string.h>
+
+void AnimPlayer::begin(const AnimPack* animPack, AnimFrameCache* frameCache) {
+  pack = animPack;
+  cache = frameCache;
+  if (cache) {
+    cache->clear();
+    cache->pinClip(pack, nullptr);
+  }
+  clip = nullptr;
+  done = false;
+  prefetched = false;
+  showingBlend = false;
+  current = 0;
+  memset(buffers, 0, sizeof(buffers));
+}
+
+bool AnimPlayer::play(const char* clipName) {
+  clip = pack ? pack->clip(pack->findClip(clipName)) : nullptr;
+  position = 0;
+  introFrames = 0;
+  bodyFrames = 0;
+  started = false;
+  prefetched = false;
+  showingBlend = false;
+  done = clip == nullptr;
+  if (cache) {
+    cache->pinClip(pack, clip);
+  }
+  if (!clip) {
+    return false;
+  }
+
+  looping = clip->flags & ANIM_CLIP_LOOP;
+  for (uint16_t i = 0; i < clip->segmentCount; i++) {
+    uint16_t frames = pack->segment(clip->firstSegment + i)->frameCount;
+    if (i < clip->loopSegment) {
+      introFrames += frames;
+    } else {
+      bodyFrames += frames;
+    }
+  }
+  return true;
+}
+
+// Frames in one pass over the loop body
+uint32_t AnimPlayer::cycleLength() const {
+  if (clip->mode != ANIM_PLAY_PINGPONG || bodyFrames < 2) {
+    return bodyFrames;
+  }
+  // Looping doesn't repeat the first frame, a single pass ends back on it
+  return looping ? 2 * bodyFrames - 2 : 2 * bodyFrames - 1;
+}
+
+bool AnimPlayer::frameAt(uint16_t segmentStart, uint16_t segmentEnd, uint32_t pos,
+                         uint16_t* index, bool* backward) const {
+  for (uint16_t i = segmentStart; i < segmentEnd; i++) {
+    const AnimSegment* segment = pack->segment(clip->firstSegment + i);
+    if (pos < segment->frameCount) {
+      *backward = segment->flags & ANIM_SEGMENT_REVERSE;
+      *index = *backward ? segment->firstFrame + segment->frameCount - 1 - pos : segment->firstFrame + pos;
+      return true;
+    }
+    pos -= segment->frameCount;
+  }
+  return false;
+}
+
+// Stored frame shown at `position` and whether the player walks backwards to it
+bool AnimPlayer::nextFrame(uint16_t* index, bool* backward) const {
+  if (position < introFrames) {
+    return frameAt(0, clip->loopSegment, position, index, backward);
+  }
+
+  uint32_t pos = position - introFrames;
+  bool flip = false;
+  if (clip->mode == ANIM_PLAY_REVERSE) {
+    pos = bodyFrames - 1 - pos;
+    flip = true;
+  } else if (clip->mode == ANIM_PLAY_PINGPONG && pos >= bodyFrames) {
+    pos = 2 * bodyFrames - 2 - pos;
+    flip = true;
+  }
+
+  if (!frameAt(clip->loopSegment, clip->segmentCount, pos, index, backward)) {
+    return false;
+  }
+  *backward ^= flip;
+  return true;
+}
+
+bool AnimPlayer::isPlaying(const char* clipName) const {
+  return clip && strncmp(clip->name, clipName, ANIM_CLIP_NAME_LEN) == 0;
+}
+
+// Decodes the frame at `position` into `target`, which holds the frame shown before it
+bool AnimPlayer::decodeNext(uint8_t* target) {
+  uint16_t index = 0;
+  uint16_t applied = 0;
+  bool backward = false;
+  bool ok = nextFrame(&index, &backward);
+
+  unsigned long start = micros();
+  bool hit = ok && cache && cache->fetch(index, target);
+  ok = ok && (hit || pack->stepTo(index, backward, target, &applied));
+  uint32_t elapsed = micros() - start;
+  if (ok && cache && !hit) {
+    cache->store(index, target, elapsed);
+  }
+
+  if (!ok) {
+    perf.decodeErrors++;
+    return false;
+  }
+
+  perf.framesDecoded++;
+  perf.lastDecodeUs = elapsed;
+  perf.totalDecodeUs += elapsed;
+  if (elapsed > perf.maxDecodeUs) {
+    perf.maxDecodeUs = elapsed;
+  }
+  if (pack->decodeBudgetUs() && elapsed > pack->decodeBudgetUs()) {
+    perf.overBudget++;
+  }
+
+  // Codec stats only count real decodes, cache hits are on the cache
+  if (!hit) {
+    const AnimFrameHeader* header = pack->frame(applied);
+    AnimCodecStats& codec = perf.codecs[header->codec];
+    codec.frames++;
+    codec.bytes += header->payloadSize;
+    codec.totalUs += elapsed;
+    if (elapsed > codec.maxUs) {
+      codec.maxUs = elapsed;
+    }
+  }
+  return true;
+}
+
+void AnimPlayer::advance() {
+  position++;
+  if (position >= introFrames + cycleLength()) {
+    if (looping) {
+      position = introFrames;
+    } else {
+      done = true;
+    }
+  }
+}
+
+bool AnimPlayer::prefetch() {
+  if (!prefetchEnabled || prefetched || !clip || done) {
+    return false;
+  }
+
+  uint8_t* next = buffers[current ^ 1];
+  memcpy(next, buffers[current], ANIM_FRAME_BYTES);
+  prefetchOk = decodeNext(next);
+  prefetched = true;
+  return true;
+}
+
+uint8_t AnimPlayer::blendMode() const {
+  if (interpolation != ANIM_INTERPOLATE_CLIP) {
+    if (interpolation >= ANIM_BLEND_MODE_COUNT) {
+      return ANIM_BLEND_NONE;
+    }
+    return interpolation;
+  }
+  if (!clip) {
+    return ANIM_BLEND_NONE;
+  }
+  if (clip->flags & ANIM_CLIP_MORPH) {
+    return ANIM_BLEND_MORPH;
+  }
+  return clip->flags & ANIM_CLIP_DITHER ? ANIM_BLEND_DITHER : ANIM_BLEND_NONE;
+}
+
+// Blends the shown frame and the prefetched next one into blendBuffer
+bool AnimPlayer::showBlend() {
+  uint8_t mode = blendMode();
+  if (mode == ANIM_BLEND_NONE) {
+    return false;
+  }
+  prefetch();
+  if (!prefetched || !prefetchOk) {
+    return false;
+  }
+
+  unsigned long start = micros();
+  animBlend(buffers[current], buffers[current ^ 1], blendBuffer, mode, ANIM_BLEND_LEVELS / 2);
+  uint32_t elapsed = micros() - start;
+  perf.framesInterpolated++;
+  perf.lastInterpUs = elapsed;
+  perf.totalInterpUs += elapsed;
+  if (elapsed > perf.maxInterpUs) {
+    perf.maxInterpUs = elapsed;
+  }
+  showingBlend = true;
+  return true;
+}
+
+uint32_t AnimPlayer::msUntilUpdate(unsigned long nowMs) const {
+  if (!clip || done || !started) {
+    return 0;
+  }
+  uint32_t due = clip->frameDelayMs;
+  if (!showingBlend && blendMode() != ANIM_BLEND_NONE) {
+    due /= 2;
+  }
+  uint32_t elapsed = nowMs - lastFrameTime;
+  return elapsed < due ? due - elapsed : 0;
+}
+
+bool AnimPlayer::update(unsigned long nowMs) {
+  if (!clip || done) {
+    return false;
+  }
+  if (started && nowMs - lastFrameTime < clip->frameDelayMs) {
+    // Halfway to the next frame, once per frame
+    if (!showingBlend && nowMs - lastFrameTime >= clip->frameDelayMs / 2u) {
+      return showBlend();
+    }
+    return false;
+  }
+
+  bool ok;
+  if (prefetched) {
+    ok = prefetchOk;
+    if (ok) {
+      current ^= 1;
+      perf.framesPrefetched++;
+    }
+    prefetched = false;
+  } else {
+    ok = decodeNext(buffers[current]);
+  }
+
+  unsigned long readyUs = micros();
+  if (started && ok) {
+    unsigned long dueUs = lastFrameUs + clip->frameDelayMs * 1000UL;
+    uint32_t late = (long)(readyUs - dueUs) > 0 ? readyUs - dueUs : 0;
+    perf.framesTimed++;
+    perf.lastLateUs = late;
+    perf.totalLateUs += late;
+    if (late > perf.maxLateUs) {
+      perf.maxLateUs = late;
+    }
+    if (late > ANIM_HITCH_US) {
+      perf.hitches++;
+    }
+  }
+
+  lastFrameTime = nowMs;
+  lastFrameUs = readyUs;
+  started = true;
+  showingBlend = false;
+
+  if (!ok) {
+    // Keep showing the last good frame and stop, a broken delta chain
+    // would only get worse from here
+    done = true;
+    return false;
+  }
+
+  advance();
+  return true;
+}
+
+void AnimPlayer::resetStats() {
+  memset(&perf, 0, sizeof(perf));
+}
@@ -0,0 +1,131 @@
+// Clip playback on top of AnimPack
+// Keeps the current frame in its own DRAM buffer (deltas need the previous
+// frame, and overlays drawn into the display buffer must not leak into it)
+// and times every decode so codec choices can be checked on the device.
+// prefetch() decodes the next frame into a second buffer right after a
+// frame is shown, so at the deadline update() only swaps buffers and the
+// frame doesn't depend on flash - which is slow right after NVS writes or
+// erases have flushed the flash cache.
+// Clips flagged for interpolation also show a frame blended from the shown
+// and the prefetched one halfway through the delay, doubling the frame rate
+// without storing more frames.
+
+#ifndef ANIM_PLAYER_H
+#define ANIM_PLAYER_H
+
+#include "anim_blend.h"
+#include "anim_cache.h"
+#include "anim_pack.h"
+
+struct AnimCodecStats {
+  uint32_t frames;
+  uint64_t bytes;     // Totals are 64 bit, 32 wrap on a device left running
+  uint64_t totalUs;
+  uint32_t maxUs;
+};
+
+// A frame ready this late is a visible stutter
+#define ANIM_HITCH_US 20000
+
+// setInterpolation() value that follows the clip flags
+#define ANIM_INTERPOLATE_CLIP 0xff
+
+struct AnimPerfStats {
+  uint32_t framesDecoded;
+  uint32_t framesPrefetched;  // Shown from the prefetch buffer
+  uint32_t decodeErrors;
+  uint32_t overBudget;
+  uint32_t lastDecodeUs;
+  uint32_t maxDecodeUs;
+  uint64_t totalDecodeUs;
+  // When frames were ready compared to when they were due
+  uint32_t lastLateUs;
+  uint32_t maxLateUs;
+  uint64_t totalLateUs;
+  uint32_t framesTimed;
+  uint32_t hitches;
+  // In-between frames and the time spent blending them
+  uint32_t framesInterpolated;
+  uint32_t lastInterpUs;
+  uint32_t maxInterpUs;
+  uint64_t totalInterpUs;
+  AnimCodecStats codecs[ANIM_CODEC_COUNT];
+};
+
+class AnimPlayer {
+public:
+  // A cache is optional, it is cleared here since frame indexes belong to the pack
+  void begin(const AnimPack* animPack, AnimFrameCache* frameCache = nullptr);
+
+  // Starts a clip from its first frame, returns false if the pack doesn't have it.
+  // Looping and play mode come from the clip entry.
+  bool play(const char* clipName);
+  bool isPlaying(const char* clipName) const;
+
+  // Shows the next frame once it is due, or an in-between frame halfway
+  // there, returns true when frame() changed
+  bool update(unsigned long nowMs);
+  // Time until update() has the next frame or in-between frame to show,
+  // 0 if it is due now or nothing is playing
+  uint32_t msUntilUpdate(unsigned long nowMs) const;
+
+  // Decodes the next frame ahead of its deadline, call whenever there is
+  // time after update(). Returns true if it decoded something.
+  bool prefetch();
+  void setPrefetch(bool enabled) { prefetchEnabled = enabled; prefetched = false; }
+
+  // AnimBlendMode for every clip, or ANIM_INTERPOLATE_CLIP to use the clip
+  // flags. In-between frames need prefetch.
+  void setInterpolation(uint8_t mode) { interpolation = mode; }
+  uint8_t interpolationSetting() const { return interpolation; }
+  // Mode used for the current clip
+  uint8_t blendMode() const;
+
+  // A play-once clip has shown its last frame
+  bool finished() const { return done; }
+
+  // Frames in one play-through: the intro plus one pass over the body
+  uint32_t sequenceLength() const { return clip ? introFrames + cycleLength() : 0; }
+
+  const uint8_t* frame() const { return showingBlend ? blendBuffer : buffers[current]; }
+  const AnimClipEntry* currentClip() const { return clip; }
+
+  const AnimPerfStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  uint32_t cycleLength() const;
+  bool frameAt(uint16_t segmentStart, uint16_t segmentEnd, uint32_t pos, uint16_t* index, bool* backward) const;
+  bool nextFrame(uint16_t* index, bool* backward) const;
+  bool decodeNext(uint8_t* target);
+  void advance();
+  bool showBlend();
+
+  const AnimPack* pack = nullptr;
+  AnimFrameCache* cache = nullptr;
+  const AnimClipEntry* clip = nullptr;
+  uint32_t position = 0;     // Frames shown since play(), wraps back to the loop body
+  uint32_t introFrames = 0;
+  uint32_t bodyFrames = 0;
+  bool looping = false;
+  bool started = false;
+  bool done = false;
+  unsigned long lastFrameTime = 0;
+  unsigned long lastFrameUs = 0;
+
+  // The frame on screen and the next one, swapped when a prefetched frame is shown
+  alignas(4) uint8_t buffers[2][ANIM_FRAME_BYTES];
+  uint8_t current = 0;
+  bool prefetchEnabled = true;
+  bool prefetched = false;
+  bool prefetchOk = false;
+
+  // The in-between frame, shown instead of buffers[current] while showingBlend
+  alignas(4) uint8_t blendBuffer[ANIM_FRAME_BYTES];
+  uint8_t interpolation = ANIM_INTERPOLATE_CLIP;
+  bool showingBlend = false;
+
+  AnimPerfStats perf = {};
+};
+
+#endif
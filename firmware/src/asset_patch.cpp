@@ -0,0 +1,102 @@
+#include "asset_patch.h"
+
+#include <esp_rom_crc.h>
+
+static size_t recordSize(const AnimFrameHeader* frame) {
+  return sizeof(AnimFrameHeader) + frame->payloadSize;
+}
+
+uint32_t AssetPatch::recordHash(const AnimPack* pack, uint16_t index) {
+  const AnimFrameHeader* frame = pack->frame(index);
+  return frame ? esp_rom_crc32_le(0, (const uint8_t*)frame, recordSize(frame)) : 0;
+}
+
+void AssetPatch::begin(AssetUpload* target, const AnimPack* current) {
+  upload = target;
+  source = current;
+  state = PATCH_OP;
+  fieldFill = 0;
+  literalLeft = 0;
+}
+
+bool AssetPatch::fail(const char* message) {
+  upload->abort(message);
+  return false;
+}
+
+bool AssetPatch::copyRecord(uint16_t index) {
+  const AnimFrameHeader* frame = source ? source->frame(index) : nullptr;
+  if (!frame) {
+    return fail("patch copies a missing frame");
+  }
+  return upload->write((const uint8_t*)frame, recordSize(frame));
+}
+
+bool AssetPatch::write(const uint8_t* data, size_t len) {
+  if (!upload || !upload->isActive()) {
+    return false;
+  }
+
+  while (len > 0) {
+    switch (state) {
+      case PATCH_OP: {
+        uint8_t op = *data++;
+        len--;
+        fieldFill = 0;
+        if (op == ASSET_PATCH_LITERAL) {
+          state = PATCH_LENGTH;
+        } else if (op == ASSET_PATCH_COPY) {
+          state = PATCH_INDEX;
+        } else {
+          return fail("unknown patch op");
+        }
+        break;
+      }
+
+      case PATCH_LENGTH:
+        field[fieldFill++] = *data++;
+        len--;
+        if (fieldFill == 4) {
+          literalLeft = field[0] | (field[1] << 8) | (field[2] << 16) | ((uint32_t)field[3] << 24);
+          state = literalLeft ? PATCH_LITERAL : PATCH_OP;
+        }
+        break;
+
+      case PATCH_INDEX:
+        field[fieldFill++] = *data++;
+        len--;
+        if (fieldFill == 2) {
+          state = PATCH_OP;
+          if (!copyRecord(field[0] | (field[1] << 8))) {
+            return false;
+          }
+        }
+        break;
+
+      case PATCH_LITERAL: {
+        size_t chunk = len < literalLeft ? len : literalLeft;
+        if (!upload->write(data, chunk)) {
+          return false;
+        }
+        data += chunk;
+        len -= chunk;
+        literalLeft -= chunk;
+        if (literalLeft == 0) {
+          state = PATCH_OP;
+        }
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+bool AssetPatch::finish() {
+  if (!upload || !upload->isActive()) {
+    return false;
+  }
+  if (state != PATCH_OP) {
+    return fail("patch ends mid-op");
+  }
+  return upload->finish();
+}
@@ -0,0 +1,42 @@
+// Rebuilds a pack from a patch stream instead of the full blob
+// The stream is a list of ops that reproduce the new pack byte for byte:
+// literal bytes (tables, changed frames, padding) and copies of frame
+// records the current pack already has, matched by the CRC32s listed on
+// GET /api/assets/hashes. Small art edits then upload only what changed.
+// Output goes through AssetUpload, so it is verified against the CRC32 of
+// the whole new pack like a full upload.
+
+#ifndef ASSET_PATCH_H
+#define ASSET_PATCH_H
+
+#include "anim_pack.h"
+#include "asset_upload.h"
+
+// Patch ops - must match tools/animpack.py
+#define ASSET_PATCH_LITERAL 0x01  // u32 length, then that many bytes
+#define ASSET_PATCH_COPY 0x02     // u16 frame index in the current pack
+
+class AssetPatch {
+public:
+  void begin(AssetUpload* target, const AnimPack* current);
+  bool write(const uint8_t* data, size_t len);
+  bool finish();
+
+  // CRC32 of a frame record (header and payload) as listed for the client
+  static uint32_t recordHash(const AnimPack* pack, uint16_t index);
+
+private:
+  enum State : uint8_t { PATCH_OP, PATCH_LENGTH, PATCH_INDEX, PATCH_LITERAL };
+
+  bool fail(const char* message);
+  bool copyRecord(uint16_t index);
+
+  AssetUpload* upload = nullptr;
+  const AnimPack* source = nullptr;
+  State state = PATCH_OP;
+  uint8_t field[4];
+  uint8_t fieldFill = 0;
+  uint32_t literalLeft = 0;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "asset_store.h"
+
+#include <string.h>
+
+#include "anim_pack.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_partition.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool AssetStore::checkHeader(const void* headerData, size_t available) {
+  const AnimPackHeader* header = (const AnimPackHeader*)headerData;
+  if (memcmp(header->magic, "TABP", 4) != 0) {
+    lastError = "no animation pack (upload_assets not run?)";
+    return false;
+  }
+  if (header->version != ANIM_PACK_VERSION) {
+    lastError = "animation pack version mismatch";
+    return false;
+  }
+  if (header->totalSize < sizeof(AnimPackHeader) || header->totalSize > available) {
+    lastError = "animation pack size invalid";
+    return false;
+  }
+  return true;
+}
+
+#ifdef ESP_PLATFORM
+
+bool AssetStore::begin(const char* label, uint8_t slot) {
+  end();
+
+  const esp_partition_t* partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!partition) {
+    lastError = "assets partition not found";
+    return false;
+  }
+
+  if (slot >= ASSET_SLOT_COUNT) {
+    lastError = "invalid assets slot";
+    return false;
+  }
+  size_t slotSize = partition->size / ASSET_SLOT_COUNT;
+  size_t slotOffset = slot * slotSize;
+
+  AnimPackHeader header;
+  if (esp_partition_read(partition, slotOffset, &header, sizeof(header)) != ESP_OK) {
+    lastError = "assets partition read failed";
+    return false;
+  }
+  if (!checkHeader(&header, slotSize)) {
+    return false;
+  }
+
+  const void* ptr = nullptr;
+  spi_flash_mmap_handle_t handle;
+  if (esp_partition_mmap(partition, slotOffset, header.totalSize, SPI_FLASH_MMAP_DATA, &ptr, &handle) != ESP_OK) {
+    lastError = "assets partition mmap failed";
+    return false;
+  }
+
+  mapped = (const uint8_t*)ptr;
+  mappedSize = header.totalSize;
+  mmapHandle = handle;
+  mappedSlot = slot;
+  return true;
+}
+
+size_t AssetStore::slotCapacity(const char* label) {
+  const esp_partition_t* partition =
+      esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  return partition ? partition->size / ASSET_SLOT_COUNT : 0;
+}
+
+void AssetStore::end() {
+  if (mapped) {
+    spi_flash_munmap(mmapHandle);
+  }
+  mapped = nullptr;
+  mappedSize = 0;
+}
+
+#else
+
+bool AssetStore::begin(const char* path, uint8_t slot) {
+  end();
+  (void)slot;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    lastError = "pack file not found";
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AnimPackHeader)) {
+    close(fd);
+    lastError = "pack file too small";
+    return false;
+  }
+
+  void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    lastError = "pack file mmap failed";
+    return false;
+  }
+
+  if (!checkHeader(ptr, st.st_size)) {
+    munmap(ptr, st.st_size);
+    return false;
+  }
+
+  mapped = (const uint8_t*)ptr;
+  mappedSize = ((const AnimPackHeader*)ptr)->totalSize;
+  fileSize = st.st_size;
+  return true;
+}
+
+size_t AssetStore::slotCapacity(const char* path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void AssetStore::end() {
+  if (mapped) {
+    munmap((void*)mapped, fileSize);
+  }
+  mapped = nullptr;
+  mappedSize = 0;
+}
+
+#endif
@@ -0,0 +1,49 @@
+// Read-only, zero-copy view of the animation pack
+// On the ESP32 the `assets` flash partition is mapped into the data address
+// space with esp_partition_mmap, so frames are read in place through the
+// flash cache and art changes don't need a firmware rebuild. Host builds
+// map a file that stands in for the partition.
+
+#ifndef ASSET_STORE_H
+#define ASSET_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSET_PARTITION_LABEL "assets"
+
+// The partition is split into A/B slots so a new pack can be uploaded next
+// to the one being played and switched to once it is verified
+#define ASSET_SLOT_COUNT 2
+
+class AssetStore {
+public:
+  // Partition label and slot on the device, file path on the host (a single
+  // slot). Only maps the pack if the header has the right magic, version and size.
+  bool begin(const char* source, uint8_t slot = 0);
+  void end();
+
+  // Largest pack a slot can hold, 0 without an assets partition
+  static size_t slotCapacity(const char* source);
+
+  bool isMapped() const { return mapped != nullptr; }
+  const uint8_t* data() const { return mapped; }
+  size_t size() const { return mappedSize; }
+  uint8_t slot() const { return mappedSlot; }
+  const char* error() const { return lastError; }
+
+private:
+  bool checkHeader(const void* header, size_t available);
+
+  const uint8_t* mapped = nullptr;
+  size_t mappedSize = 0;
+  uint8_t mappedSlot = 0;
+  const char* lastError = "";
+#ifdef ESP_PLATFORM
+  uint32_t mmapHandle = 0;
+#else
+  size_t fileSize = 0;
+#endif
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include "asset_upload.h"
+
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <string.h>
+
+#include "anim_pack.h"
+#include "asset_store.h"
+
+bool AssetUpload::fail(const char* message) {
+  lastError = message;
+  active = false;
+  return false;
+}
+
+bool AssetUpload::open(const char* label, uint8_t slot, uint32_t size) {
+  active = false;
+  complete = false;
+  receivedBytes = 0;
+  writtenBytes = 0;
+  sectorFill = 0;
+  crc = 0;
+  lastError = "";
+
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (!partition) {
+    return fail("assets partition not found");
+  }
+  if (slot >= ASSET_SLOT_COUNT) {
+    return fail("invalid assets slot");
+  }
+
+  uint32_t slotSize = partition->size / ASSET_SLOT_COUNT;
+  if (size < sizeof(AnimPackHeader) || size > slotSize) {
+    return fail("pack size doesn't fit the assets slot");
+  }
+
+  targetSlot = slot;
+  slotOffset = slot * slotSize;
+  expectedSize = size;
+  return true;
+}
+
+bool AssetUpload::begin(const char* label, uint8_t slot, uint32_t size, uint32_t crc32) {
+  if (!open(label, slot, size)) {
+    return false;
+  }
+  expectedCrc = crc32;
+  active = true;
+  return true;
+}
+
+bool AssetUpload::resume(const char* label, const AssetUploadProgress& saved) {
+  if (!open(label, saved.slot, saved.size)) {
+    return false;
+  }
+  if (saved.written % ASSET_SECTOR_SIZE || saved.written > saved.size) {
+    return fail("saved upload progress invalid");
+  }
+
+  // Whatever was written before the reboot has to still be there
+  uint32_t check = 0;
+  for (uint32_t offset = 0; offset < saved.written; offset += ASSET_SECTOR_SIZE) {
+    if (esp_partition_read(partition, slotOffset + offset, sector, ASSET_SECTOR_SIZE) != ESP_OK) {
+      return fail("flash read failed");
+    }
+    check = esp_rom_crc32_le(check, sector, ASSET_SECTOR_SIZE);
+  }
+  if (check != saved.writtenCrc) {
+    return fail("saved upload doesn't match flash");
+  }
+
+  expectedCrc = saved.crc32;
+  receivedBytes = saved.written;
+  writtenBytes = saved.written;
+  crc = check;
+  active = true;
+  return true;
+}
+
+AssetUploadProgress AssetUpload::progress() const {
+  AssetUploadProgress saved = {};
+  saved.size = expectedSize;
+  saved.crc32 = expectedCrc;
+  saved.written = writtenBytes;
+  saved.writtenCrc = crc;
+  saved.slot = targetSlot;
+  return saved;
+}
+
+bool AssetUpload::flushSector() {
+  if (sectorFill == 0) {
+    return true;
+  }
+
+  int64_t start = esp_timer_get_time();
+  if (esp_partition_erase_range(partition, slotOffset + writtenBytes, ASSET_SECTOR_SIZE) != ESP_OK) {
+    return fail("flash erase failed");
+  }
+  if (esp_partition_write(partition, slotOffset + writtenBytes, sector, sectorFill) != ESP_OK) {
+    return fail("flash write failed");
+  }
+  uint32_t elapsed = esp_timer_get_time() - start;
+  sectorUs = sectorUs ? (sectorUs * 3 + elapsed) / 4 : elapsed;
+
+  crc = esp_rom_crc32_le(crc, sector, sectorFill);
+  writtenBytes += sectorFill;
+  sectorFill = 0;
+  return true;
+}
+
+bool AssetUpload::write(const uint8_t* data, size_t len) {
+  if (!active) {
+    return false;
+  }
+  if (receivedBytes + len > expectedSize) {
+    return fail("more data than announced");
+  }
+
+  receivedBytes += len;
+  while (len > 0) {
+    size_t chunk = ASSET_SECTOR_SIZE - sectorFill;
+    if (chunk > len) {
+      chunk = len;
+    }
+    memcpy(sector + sectorFill, data, chunk);
+    sectorFill += chunk;
+    data += chunk;
+    len -= chunk;
+
+    if (sectorFill == ASSET_SECTOR_SIZE && !flushSector()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AssetUpload::finish() {
+  if (!active) {
+    return false;
+  }
+  if (!flushSector()) {
+    return false;
+  }
+  if (writtenBytes != expectedSize) {
+    return fail("upload incomplete");
+  }
+  if (crc != expectedCrc) {
+    return fail("checksum mismatch");
+  }
+
+  // Read back through the sector buffer, the transfer was fine but the
+  // write may not have been
+  uint32_t check = 0;
+  for (uint32_t offset = 0; offset < expectedSize; offset += ASSET_SECTOR_SIZE) {
+    uint32_t chunk = expectedSize - offset < ASSET_SECTOR_SIZE ? expectedSize - offset : ASSET_SECTOR_SIZE;
+    if (esp_partition_read(partition, slotOffset + offset, sector, chunk) != ESP_OK) {
+      return fail("flash read failed");
+    }
+    check = esp_rom_crc32_le(check, sector, chunk);
+  }
+  if (check != expectedCrc) {
+    return fail("flash verify failed");
+  }
+
+  active = false;
+  complete = true;
+  return true;
+}
+
+void AssetUpload::abort(const char* reason) {
+  if (active) {
+    lastError = reason;
+  }
+  active = false;
+}
+
+void AssetUpload::clear() {
+  active = false;
+  complete = false;
+  lastError = "";
+}
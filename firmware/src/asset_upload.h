@@ -0,0 +1,74 @@
+// Streams a new animation pack into one slot of the assets partition
+// Data arrives in whatever pieces the HTTP server reads and is written one
+// flash sector at a time, so the pack never has to fit in RAM. finish()
+// checks the CRC32 of the written bytes and reads the slot back to make
+// sure flash holds the same thing.
+// An upload can span many requests and survive a reboot: progress() is
+// only ever at a sector boundary that is already in flash, and resume()
+// picks up from there after checking the written part again.
+
+#ifndef ASSET_UPLOAD_H
+#define ASSET_UPLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <esp_partition.h>
+
+#define ASSET_SECTOR_SIZE 4096
+
+// What has to survive a reboot to continue an upload
+struct AssetUploadProgress {
+  uint32_t size;
+  uint32_t crc32;       // Of the whole pack
+  uint32_t written;     // Bytes in flash, a multiple of ASSET_SECTOR_SIZE
+  uint32_t writtenCrc;  // CRC32 of those bytes
+  uint8_t slot;
+  uint8_t reserved[3];
+};
+
+class AssetUpload {
+public:
+  bool begin(const char* label, uint8_t slot, uint32_t size, uint32_t crc32);
+  bool resume(const char* label, const AssetUploadProgress& saved);
+  bool write(const uint8_t* data, size_t len);
+  bool finish();
+  void abort(const char* reason = "upload aborted");
+  // Forgets the finished or failed upload once the request is answered
+  void clear();
+
+  bool isActive() const { return active; }
+  bool isComplete() const { return complete; }
+  bool matches(uint32_t size, uint32_t crc32) const { return active && size == expectedSize && crc32 == expectedCrc; }
+  uint8_t slot() const { return targetSlot; }
+  uint32_t received() const { return receivedBytes; }
+  uint32_t size() const { return expectedSize; }
+  const char* error() const { return lastError; }
+  AssetUploadProgress progress() const;
+
+  // Smoothed time to erase and write one sector, 0 until one was written
+  uint32_t sectorWriteUs() const { return sectorUs; }
+
+private:
+  bool open(const char* label, uint8_t slot, uint32_t size);
+  bool flushSector();
+  bool fail(const char* message);
+
+  const esp_partition_t* partition = nullptr;
+  uint32_t slotOffset = 0;
+  uint32_t expectedSize = 0;
+  uint32_t expectedCrc = 0;
+  uint32_t crc = 0;             // Of the bytes in flash
+  uint32_t receivedBytes = 0;
+  uint32_t writtenBytes = 0;
+  uint32_t sectorUs = 0;
+  size_t sectorFill = 0;
+  uint8_t targetSlot = 0;
+  bool active = false;
+  bool complete = false;
+  const char* lastError = "";
+
+  uint8_t sector[ASSET_SECTOR_SIZE];
+};
+
+#endif
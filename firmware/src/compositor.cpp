@@ -0,0 +1,141 @@
+#include "compositor.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+void Compositor::begin(const Zone* layout, uint8_t count, unsigned long nowMs) {
+  zoneCount = count < COMPOSITOR_MAX_ZONES ? count : COMPOSITOR_MAX_ZONES;
+  for (uint8_t i = 0; i < zoneCount; i++) {
+    zones[i] = layout[i];
+    dueMs[i] = nowMs;
+    dirty[i] = true;
+  }
+  // The panel shows whatever the state before left on it
+  shadowValid = false;
+}
+
+void Compositor::end() {
+  zoneCount = 0;
+  shadowValid = false;
+}
+
+void Compositor::invalidate(uint8_t zone) {
+  if (zone < zoneCount) {
+    dirty[zone] = true;
+  }
+}
+
+void Compositor::setPeriod(uint8_t zone, uint16_t periodMs, unsigned long nowMs) {
+  if (zone < zoneCount && zones[zone].periodMs != periodMs) {
+    zones[zone].periodMs = periodMs;
+    dueMs[zone] = nowMs;
+  }
+}
+
+void Compositor::resetStats() {
+  perf = {};
+}
+
+void Compositor::drawZone(U8G2& display, uint8_t index, unsigned long nowMs) {
+  const Zone& zone = zones[index];
+  uint8_t* buffer = display.getBufferPtr();
+  for (uint8_t page = zone.y; page < zone.y + zone.h; page++) {
+    memset(buffer + page * ANIM_FRAME_WIDTH + zone.x * 8, 0, zone.w * 8);
+  }
+  display.setClipWindow(zone.x * 8, zone.y * 8, (zone.x + zone.w) * 8, (zone.y + zone.h) * 8);
+  zone.draw(display, nowMs);
+  display.setMaxClipWindow();
+
+  dirty[index] = false;
+  if (zone.periodMs) {
+    // Stays on its beat unless it fell a whole period behind
+    dueMs[index] += zone.periodMs;
+    if ((long)(nowMs - dueMs[index]) >= 0) {
+      dueMs[index] = nowMs + zone.periodMs;
+    }
+  }
+  perf.zoneDraws++;
+  perf.tilesDrawn += zone.w * zone.h;
+}
+
+// Sends the runs of changed tiles in each page of the zone
+void Compositor::sendZone(U8G2& display, const Zone& zone) {
+  const uint8_t* buffer = display.getBufferPtr();
+  for (uint8_t page = zone.y; page < zone.y + zone.h; page++) {
+    uint8_t tile = zone.x;
+    while (tile < zone.x + zone.w) {
+      uint16_t offset = page * ANIM_FRAME_WIDTH + tile * 8;
+      if (memcmp(buffer + offset, shadow + offset, 8) == 0) {
+        tile++;
+        continue;
+      }
+      uint8_t start = tile;
+      do {
+        memcpy(shadow + offset, buffer + offset, 8);
+        tile++;
+        offset += 8;
+      } while (tile < zone.x + zone.w && memcmp(buffer + offset, shadow + offset, 8) != 0);
+      display.updateDisplayArea(start, page, tile - start, 1);
+      perf.areaSends++;
+      perf.tilesSent += tile - start;
+    }
+  }
+}
+
+bool Compositor::update(U8G2& display, unsigned long nowMs, bool send) {
+  uint32_t start = micros();
+  uint8_t drawn = 0;
+  for (uint8_t i = 0; i < zoneCount; i++) {
+    if (dirty[i] || (zones[i].periodMs && (long)(nowMs - dueMs[i]) >= 0)) {
+      drawZone(display, i, nowMs);
+      drawn |= 1 << i;
+    }
+  }
+  if (!drawn) {
+    return false;
+  }
+
+  if (!send) {
+    // The transition sends its own frames
+    shadowValid = false;
+  } else if (!shadowValid) {
+    display.sendBuffer();
+    memcpy(shadow, display.getBufferPtr(), ANIM_FRAME_BYTES);
+    shadowValid = true;
+    perf.fullSends++;
+    perf.tilesSent += ANIM_FRAME_BYTES / 8;
+  } else {
+    for (uint8_t i = 0; i < zoneCount; i++) {
+      if (drawn & (1 << i)) {
+        sendZone(display, zones[i]);
+      }
+    }
+  }
+
+  perf.updates++;
+  perf.lastUpdateUs = micros() - start;
+  if (perf.lastUpdateUs > perf.maxUpdateUs) {
+    perf.maxUpdateUs = perf.lastUpdateUs;
+  }
+  return true;
+}
+
+uint32_t Compositor::msUntilUpdate(unsigned long nowMs) const {
+  uint32_t next = UINT32_MAX;
+  for (uint8_t i = 0; i < zoneCount; i++) {
+    if (dirty[i]) {
+      return 0;
+    }
+    if (!zones[i].periodMs) {
+      continue;
+    }
+    long left = (long)(dueMs[i] - nowMs);
+    if (left <= 0) {
+      return 0;
+    }
+    if ((uint32_t)left < next) {
+      next = left;
+    }
+  }
+  return next;
+}
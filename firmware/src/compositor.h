@@ -0,0 +1,84 @@
+// Screen zones with their own refresh rates
+// A screen made of parts that change at different rates (a face at clip fps,
+// a countdown once a second, a task name almost never) used to be cleared
+// and redrawn as a whole, and all 1 KB sent every pass. A layout splits the
+// screen into zones of whole 8x8 tiles, each redrawn when its period is up or
+// it was invalidated. Only the zones drawn are composed into the buffer, and
+// of those only the tiles that differ from what the panel holds are sent.
+
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+#include "anim_pack.h"
+
+#define COMPOSITOR_MAX_ZONES 6
+
+// Draws the zone into the display buffer. The zone is cleared and the clip
+// window set to it beforehand.
+typedef void (*ZoneDraw)(U8G2& display, unsigned long nowMs);
+
+struct Zone {
+  uint8_t x;          // In tiles, 16 across and 8 down
+  uint8_t y;
+  uint8_t w;
+  uint8_t h;
+  uint16_t periodMs;  // 0 only redraws when invalidated
+  ZoneDraw draw;
+};
+
+struct CompositorStats {
+  uint32_t updates;     // Passes that drew at least one zone
+  uint32_t zoneDraws;
+  uint32_t tilesDrawn;  // Tiles of the zones drawn
+  uint32_t tilesSent;   // Of those, the ones that changed
+  uint32_t areaSends;   // updateDisplayArea() calls
+  uint32_t fullSends;   // Whole buffer, the panel's contents weren't known
+  uint32_t lastUpdateUs;
+  uint32_t maxUpdateUs;
+};
+
+class Compositor {
+public:
+  // Starts a layout, every zone is drawn on the next update()
+  void begin(const Zone* zones, uint8_t count, unsigned long nowMs);
+  // Back to drawing whole frames
+  void end();
+  bool active() const { return zoneCount > 0; }
+
+  // Redraws the zone on the next update()
+  void invalidate(uint8_t zone);
+  // For zones whose rate depends on what they show, e.g. text that scrolls
+  void setPeriod(uint8_t zone, uint16_t periodMs, unsigned long nowMs);
+  // Something else wrote to the panel, the next send is the whole buffer
+  void invalidatePanel() { shadowValid = false; }
+
+  // Draws the zones that are due. With `send` the changed tiles go to the
+  // panel, otherwise (during a transition) the buffer is only composed.
+  // Returns true if any zone was drawn.
+  bool update(U8G2& display, unsigned long nowMs, bool send);
+  // Time until a zone is due, UINT32_MAX if none has a period
+  uint32_t msUntilUpdate(unsigned long nowMs) const;
+
+  const CompositorStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  void drawZone(U8G2& display, uint8_t index, unsigned long nowMs);
+  void sendZone(U8G2& display, const Zone& zone);
+
+  Zone zones[COMPOSITOR_MAX_ZONES];
+  uint8_t zoneCount = 0;
+  unsigned long dueMs[COMPOSITOR_MAX_ZONES];
+  bool dirty[COMPOSITOR_MAX_ZONES];
+
+  // What the panel holds, for finding the tiles that changed
+  uint8_t shadow[ANIM_FRAME_BYTES];
+  bool shadowValid = false;
+
+  CompositorStats perf = {};
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "cpu_governor.h"
+
+#include <Arduino.h>
+#include <esp_idf_version.h>
+#include <esp_pm.h>
+
+static const uint16_t STEP_MHZ[CPU_GOVERNOR_STEP_COUNT] = {80, 160, 240};
+
+// WiFi needs the 80 MHz APB clock, so that is also the floor while idle
+#define IDLE_MHZ 80
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+typedef esp_pm_config_t PmConfig;
+#else
+typedef esp_pm_config_esp32_t PmConfig;
+#endif
+
+// Fails without CONFIG_PM_ENABLE, or with light sleep but without tickless idle
+static bool configurePm(uint16_t maxMhz, bool lightSleep) {
+  PmConfig config = {};
+  config.max_freq_mhz = maxMhz;
+  config.min_freq_mhz = IDLE_MHZ;
+  config.light_sleep_enable = lightSleep;
+  return esp_pm_configure(&config) == ESP_OK;
+}
+
+void CpuGovernor::begin(const CpuGovernorConfig& config) {
+  // Without power management setCpuFrequencyMhz() sets the clock directly
+  pmAvailable = configurePm(STEP_MHZ[step], false);
+  windowStartMs = millis();
+  stepSinceMs = windowStartMs;
+  loopStartUs = micros();
+  configure(config);
+}
+
+void CpuGovernor::configure(const CpuGovernorConfig& config) {
+  settings = config;
+  if (settings.maxLatencyMs == 0) {
+    settings.maxLatencyMs = 1;
+  }
+  sleepEnabled = pmAvailable && settings.lightSleep && configurePm(STEP_MHZ[step], true);
+  if (pmAvailable && !sleepEnabled) {
+    configurePm(STEP_MHZ[step], false);
+  }
+  if (!settings.enabled) {
+    setStep(CPU_GOVERNOR_STEP_COUNT - 1);
+  }
+}
+
+uint16_t CpuGovernor::mhz() const {
+  return STEP_MHZ[step];
+}
+
+float CpuGovernor::duty() const {
+  uint64_t total = perf.busyUs + perf.sleptUs;
+  return total ? (float)perf.busyUs / total : 0;
+}
+
+void CpuGovernor::resetStats() {
+  perf = {};
+  stepSinceMs = millis();
+}
+
+void CpuGovernor::setStep(uint8_t next) {
+  unsigned long now = millis();
+  perf.msAt[step] += now - stepSinceMs;
+  stepSinceMs = now;
+  if (next == step) {
+    return;
+  }
+  step = next;
+  perf.clockChanges++;
+  if (pmAvailable) {
+    configurePm(STEP_MHZ[step], sleepEnabled);
+  } else {
+    setCpuFrequencyMhz(STEP_MHZ[step]);
+  }
+}
+
+void CpuGovernor::loopStart() {
+  unsigned long now = micros();
+  uint32_t gap = now - loopStartUs;
+  loopStartUs = now;
+  perf.loops++;
+  perf.totalGapUs += gap;
+  if (gap > perf.maxGapUs) {
+    perf.maxGapUs = gap;
+  }
+  if (gap > settings.maxLatencyMs * 1000UL) {
+    perf.latencyMisses++;
+  }
+}
+
+// Work at a slower clock takes longer by the clock ratio, which overstates
+// it for the parts waiting on I2C, flash or WiFi
+void CpuGovernor::review(unsigned long nowMs) {
+  uint32_t windowUs = (nowMs - windowStartMs) * 1000;
+  if (windowUs < CPU_GOVERNOR_WINDOW_MS * 1000UL) {
+    return;
+  }
+  float duty = (float)windowBusyUs / windowUs;
+  uint8_t next = step;
+  if (step + 1 < CPU_GOVERNOR_STEP_COUNT &&
+      (duty > CPU_GOVERNOR_DUTY_HIGH || windowMaxWorkUs > settings.workBudgetMs * 1000UL)) {
+    next = step + 1;
+  } else if (step > 0) {
+    float ratio = (float)STEP_MHZ[step] / STEP_MHZ[step - 1];
+    if (duty * ratio < CPU_GOVERNOR_DUTY_LOW && windowMaxWorkUs * ratio < settings.workBudgetMs * 1000.0f) {
+      next = step - 1;
+    }
+  }
+  setStep(next);
+
+  windowStartMs = nowMs;
+  windowBusyUs = 0;
+  windowMaxWorkUs = 0;
+}
+
+void CpuGovernor::loopEnd(uint32_t untilMs) {
+  uint32_t work = micros() - loopStartUs;
+  perf.busyUs += work;
+  windowBusyUs += work;
+  if (work > windowMaxWorkUs) {
+    windowMaxWorkUs = work;
+  }
+  if (work > perf.maxWorkUs) {
+    perf.maxWorkUs = work;
+  }
+  if (settings.enabled) {
+    review(millis());
+  }
+
+  uint32_t sleepMs = untilMs < 1 ? 1 : untilMs;
+  if (sleepMs > settings.maxLatencyMs) {
+    sleepMs = settings.maxLatencyMs;
+  }
+  unsigned long start = micros();
+  delay(sleepMs);
+  perf.sleptUs += micros() - start;
+}
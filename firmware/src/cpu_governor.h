@@ -0,0 +1,83 @@
+// CPU clock and sleep between frames
+// A frame takes a few ms of work every 83-125 ms, the rest of loop() used to
+// be delay(5) at 240 MHz. loopEnd() sleeps until the next frame is due
+// instead, but never longer than the latency bound, since HTTP requests are
+// only handled between sleeps. Every window the measured work picks the
+// slowest clock (80/160/240 MHz) that still does it within the work budget.
+// Where the core has power management, automatic light sleep is enabled
+// for the sleeps; WiFi keeps its association through modem sleep. Without
+// it the sleeps are plain delay(), where the idle task halts the CPU.
+
+#ifndef CPU_GOVERNOR_H
+#define CPU_GOVERNOR_H
+
+#include <stdint.h>
+
+// How often the clock is reconsidered
+#define CPU_GOVERNOR_WINDOW_MS 2000
+// Share of the window spent working that moves the clock up, and the share
+// the next lower clock would have to stay under to move down
+#define CPU_GOVERNOR_DUTY_HIGH 0.6f
+#define CPU_GOVERNOR_DUTY_LOW 0.3f
+
+#define CPU_GOVERNOR_STEP_COUNT 3
+
+struct CpuGovernorConfig {
+  uint8_t enabled;        // Otherwise stays at 240 MHz, sleeps still follow deadlines
+  uint8_t lightSleep;
+  uint16_t maxLatencyMs;  // Longest sleep, and so the most a request waits
+  uint16_t workBudgetMs;  // Longest loop() pass a clock may take
+};
+
+#define CPU_GOVERNOR_DEFAULTS {1, 1, 50, 20}
+
+struct CpuGovernorStats {
+  uint32_t loops;
+  // µs totals are 64 bit, 32 bits wrap after 71 minutes
+  uint64_t busyUs;        // In loop(), outside sleeps
+  uint64_t sleptUs;
+  uint32_t maxWorkUs;
+  uint32_t maxGapUs;      // Longest time between two loop() starts
+  uint64_t totalGapUs;
+  uint32_t latencyMisses; // Gaps over maxLatencyMs
+  uint32_t clockChanges;
+  uint32_t msAt[CPU_GOVERNOR_STEP_COUNT];  // Time at each clock
+};
+
+class CpuGovernor {
+public:
+  void begin(const CpuGovernorConfig& config);
+  void configure(const CpuGovernorConfig& config);
+  const CpuGovernorConfig& config() const { return settings; }
+
+  // First thing in loop()
+  void loopStart();
+  // Last thing in loop(): sleeps until `untilMs` from now, at least 1 ms
+  // and at most maxLatencyMs, and moves the clock once per window
+  void loopEnd(uint32_t untilMs);
+
+  uint16_t mhz() const;
+  bool lightSleep() const { return sleepEnabled; }
+  // Share of time spent working since resetStats()
+  float duty() const;
+
+  const CpuGovernorStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  void setStep(uint8_t next);
+  void review(unsigned long nowMs);
+
+  CpuGovernorConfig settings = CPU_GOVERNOR_DEFAULTS;
+  uint8_t step = CPU_GOVERNOR_STEP_COUNT - 1;
+  bool pmAvailable = false;
+  bool sleepEnabled = false;
+  unsigned long loopStartUs = 0;
+  unsigned long windowStartMs = 0;
+  unsigned long stepSinceMs = 0;
+  uint32_t windowBusyUs = 0;
+  uint32_t windowMaxWorkUs = 0;
+  CpuGovernorStats perf = {};
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "display_governor.h"
+
+static const char* const STAGE_NAMES[GOVERNOR_STAGE_COUNT] = {"active", "slow", "dim", "sleep"};
+
+const char* DisplayGovernor::stageName(uint8_t stage) {
+  return stage < GOVERNOR_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+void DisplayGovernor::begin(const GovernorConfig& config, unsigned long nowMs) {
+  settings = config;
+  current = GOVERNOR_ACTIVE;
+  lastActivityMs = nowMs;
+  lastFrameMs = nowMs;
+  stageSinceMs = nowMs;
+}
+
+bool DisplayGovernor::activity(unsigned long nowMs) {
+  lastActivityMs = nowMs;
+  return current == GOVERNOR_SLEEP;
+}
+
+void DisplayGovernor::setTime(uint32_t epochS, int16_t utcOffsetMin, unsigned long nowMs) {
+  timeEpochS = epochS;
+  timeOffsetMin = utcOffsetMin;
+  // 0 means not set
+  timeSetMs = nowMs ? nowMs : 1;
+}
+
+uint32_t DisplayGovernor::epoch(unsigned long nowMs) const {
+  return hasTime() ? timeEpochS + (nowMs - timeSetMs) / 1000 : 0;
+}
+
+int8_t DisplayGovernor::localHour(unsigned long nowMs) const {
+  if (!hasTime()) {
+    return -1;
+  }
+  int32_t local = (int32_t)((epoch(nowMs) + timeOffsetMin * 60L) % 86400);
+  if (local < 0) {
+    local += 86400;
+  }
+  return local / 3600;
+}
+
+bool DisplayGovernor::quietHours(unsigned long nowMs) const {
+  int8_t hour = localHour(nowMs);
+  if (hour < 0 || settings.quietStart == settings.quietEnd) {
+    return false;
+  }
+  if (settings.quietStart < settings.quietEnd) {
+    return hour >= settings.quietStart && hour < settings.quietEnd;
+  }
+  // Over midnight
+  return hour >= settings.quietStart || hour < settings.quietEnd;
+}
+
+uint8_t DisplayGovernor::targetStage(unsigned long nowMs) const {
+  uint32_t idleS = idleMs(nowMs) / 1000;
+  bool quiet = quietHours(nowMs);
+  if (settings.sleepAfterS && idleS >= settings.sleepAfterS) {
+    return GOVERNOR_SLEEP;
+  }
+  if (settings.dimAfterS && idleS >= settings.dimAfterS) {
+    return quiet ? GOVERNOR_SLEEP : GOVERNOR_DIM;
+  }
+  if (settings.slowAfterS && idleS >= settings.slowAfterS) {
+    return quiet ? GOVERNOR_SLEEP : GOVERNOR_SLOW;
+  }
+  return GOVERNOR_ACTIVE;
+}
+
+void DisplayGovernor::account(unsigned long nowMs) {
+  uint32_t elapsed = nowMs - stageSinceMs;
+  perf.stageMs[current] += elapsed;
+  if (current != GOVERNOR_SLEEP) {
+    onMs += elapsed;
+  }
+  stageSinceMs = nowMs;
+}
+
+bool DisplayGovernor::update(U8G2& display, PanelEffects& effects, unsigned long nowMs) {
+  account(nowMs);
+  uint8_t target = targetStage(nowMs);
+  if (target == current) {
+    return false;
+  }
+
+  if (target == GOVERNOR_SLEEP) {
+    display.setPowerSave(1);
+    perf.sleeps++;
+  } else if (current == GOVERNOR_SLEEP) {
+    display.setPowerSave(0);
+    perf.wakes++;
+    perf.framesSkipped += (nowMs - lastFrameMs) / GOVERNOR_NOMINAL_FRAME_MS;
+    lastFrameMs = nowMs;
+  }
+  // Effects keep running, only scaled
+  effects.setContrastScale(target >= GOVERNOR_DIM ? settings.dimScale : 255);
+  current = target;
+  return true;
+}
+
+bool DisplayGovernor::frameDue(unsigned long nowMs) {
+  if (current == GOVERNOR_ACTIVE) {
+    lastFrameMs = nowMs;
+    return true;
+  }
+  if (current == GOVERNOR_SLEEP || nowMs - lastFrameMs < settings.slowFrameMs) {
+    return false;
+  }
+  // Frames the nominal rate would have drawn since the last one
+  uint32_t nominal = (nowMs - lastFrameMs) / GOVERNOR_NOMINAL_FRAME_MS;
+  if (nominal > 1) {
+    perf.framesSkipped += nominal - 1;
+  }
+  lastFrameMs = nowMs;
+  return true;
+}
+
+uint32_t DisplayGovernor::msUntilFrame(unsigned long nowMs) const {
+  if (current == GOVERNOR_SLEEP) {
+    return UINT32_MAX;
+  }
+  uint32_t elapsed = nowMs - lastFrameMs;
+  return current == GOVERNOR_ACTIVE || elapsed >= settings.slowFrameMs ? 0 : settings.slowFrameMs - elapsed;
+}
+
+uint64_t DisplayGovernor::panelOnMs(unsigned long nowMs) const {
+  return current != GOVERNOR_SLEEP ? onMs + (nowMs - stageSinceMs) : onMs;
+}
+
+void DisplayGovernor::resetStats(unsigned long nowMs) {
+  account(nowMs);
+  perf = {};
+}
@@ -0,0 +1,103 @@
+// Display power governor
+// Nobody looks at Tabbie overnight, but idle clips would play at full rate
+// forever. After a while without commands or button presses the governor
+// steps down: frames are drawn less often, then the panel is dimmed, then
+// switched off (0xAE, the SH1106 keeps its RAM). Any activity brings it
+// straight back. Once the app has sent the time, quiet hours go from slow
+// straight to off.
+
+#ifndef DISPLAY_GOVERNOR_H
+#define DISPLAY_GOVERNOR_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+#include "panel_fx.h"
+
+// Frame rate the idle clips play at, for counting the frames not drawn
+#define GOVERNOR_NOMINAL_FRAME_MS 83
+
+enum GovernorStage : uint8_t {
+  GOVERNOR_ACTIVE,
+  GOVERNOR_SLOW,
+  GOVERNOR_DIM,
+  GOVERNOR_SLEEP,
+  GOVERNOR_STAGE_COUNT
+};
+
+struct GovernorConfig {
+  uint16_t slowAfterS;   // Idle time before each stage, 0 skips the stage
+  uint16_t dimAfterS;
+  uint16_t sleepAfterS;
+  uint16_t slowFrameMs;  // Least time between frames from SLOW on
+  uint8_t dimScale;      // Contrast while dimmed, 255 is full
+  uint8_t quietStart;    // Local hours, equal turns quiet hours off
+  uint8_t quietEnd;
+};
+
+#define GOVERNOR_DEFAULTS {300, 900, 1800, 250, 32, 23, 7}
+
+struct GovernorStats {
+  uint32_t stageMs[GOVERNOR_STAGE_COUNT];  // Time spent in each stage
+  uint32_t sleeps;
+  uint32_t wakes;
+  uint32_t framesSkipped;  // Frames not drawn from SLOW on, at the nominal rate
+};
+
+class DisplayGovernor {
+public:
+  void begin(const GovernorConfig& config, unsigned long nowMs);
+  void configure(const GovernorConfig& config) { settings = config; }
+  const GovernorConfig& config() const { return settings; }
+
+  // A command or button press. Returns true if the panel was off, the press
+  // that wakes it shouldn't do anything else.
+  bool activity(unsigned long nowMs);
+
+  // Wall clock from the app: seconds since 1970 (UTC) and the local offset
+  void setTime(uint32_t epochS, int16_t utcOffsetMin, unsigned long nowMs);
+  bool hasTime() const { return timeSetMs != 0; }
+  uint32_t epoch(unsigned long nowMs) const;
+  // 0-23, or -1 without the time
+  int8_t localHour(unsigned long nowMs) const;
+
+  // Moves between stages and sends the contrast and power changes.
+  // Returns true when the stage changed.
+  bool update(U8G2& display, PanelEffects& effects, unsigned long nowMs);
+  // Whether to draw a frame now. Always true while active.
+  bool frameDue(unsigned long nowMs);
+  // Time until frameDue() is true again, UINT32_MAX while asleep
+  uint32_t msUntilFrame(unsigned long nowMs) const;
+
+  uint8_t stage() const { return current; }
+  bool asleep() const { return current == GOVERNOR_SLEEP; }
+  uint32_t idleMs(unsigned long nowMs) const { return nowMs - lastActivityMs; }
+  static const char* stageName(uint8_t stage);
+
+  // Time the panel was on since boot, resetStats() doesn't clear it. 64 bit,
+  // the device runs for longer than 32 bits of ms (49.7 days).
+  uint64_t panelOnMs(unsigned long nowMs) const;
+
+  const GovernorStats& stats() const { return perf; }
+  void resetStats(unsigned long nowMs);
+
+private:
+  uint8_t targetStage(unsigned long nowMs) const;
+  bool quietHours(unsigned long nowMs) const;
+  void account(unsigned long nowMs);
+
+  GovernorConfig settings = GOVERNOR_DEFAULTS;
+  uint8_t current = GOVERNOR_ACTIVE;
+  unsigned long lastActivityMs = 0;
+  unsigned long lastFrameMs = 0;
+  unsigned long stageSinceMs = 0;  // Accounted up to here
+  uint64_t onMs = 0;
+
+  uint32_t timeEpochS = 0;
+  int16_t timeOffsetMin = 0;
+  unsigned long timeSetMs = 0;
+
+  GovernorStats perf = {};
+};
+
+#endif
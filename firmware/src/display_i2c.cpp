@@ -0,0 +1,368 @@
+#include "display_i2c.h"
+
+#include <Arduino.h>
+#include <driver/i2c.h>
+#include <string.h>
+
+#define DISPLAY_I2C_PORT I2C_NUM_0
+
+// Control bytes: 0x80 is a command with more control bytes after it, 0x40
+// makes the rest of the transaction display data
+#define CONTROL_COMMAND 0x80
+#define CONTROL_DATA 0x40
+
+static i2c_config_t busConfig = {};
+static uint32_t busClock = 0;
+static uint8_t transfer[DISPLAY_I2C_MAX_TRANSFER];
+static uint16_t transferLength = 0;
+static bool transferOverflow = false;
+static DisplayBusStats busStats = {};
+static uint32_t tunedClock = DISPLAY_BUS_HZ;
+static uint8_t errorRun = 0;
+static int8_t canRead = -1;  // Unknown until the first test
+static bool stuck = false;
+static unsigned long stuckSinceMs = 0;
+static unsigned long retryAtMs = 0;
+static uint16_t retryMs = DISPLAY_BUS_RETRY_MS;
+
+// Clocks displayBusTune() tries, slowest first
+static const uint32_t CLOCK_STEPS[] = {DISPLAY_BUS_MIN_HZ, 400000, 600000, 800000, 1000000};
+#define CLOCK_STEP_COUNT (sizeof(CLOCK_STEPS) / sizeof(CLOCK_STEPS[0]))
+
+const DisplayBusStats& displayBusStats() {
+  return busStats;
+}
+
+void displayBusResetStats() {
+  memset(&busStats, 0, sizeof(busStats));
+}
+
+uint32_t displayBusClock() {
+  return tunedClock;
+}
+
+bool displayBusCanRead() {
+  return canRead > 0;
+}
+
+bool displayBusStuck() {
+  return stuck;
+}
+
+static void installDriver() {
+  i2c_param_config(DISPLAY_I2C_PORT, &busConfig);
+  i2c_driver_install(DISPLAY_I2C_PORT, I2C_MODE_MASTER, 0, 0, 0);
+}
+
+// Both lines are released between transactions, a low one is held by a
+// device or shorted
+static bool linesHigh() {
+  return digitalRead(busConfig.sda_io_num) == HIGH && digitalRead(busConfig.scl_io_num) == HIGH;
+}
+
+static void applyClock(u8x8_t* u8x8) {
+  if (u8x8->bus_clock == busClock) {
+    return;
+  }
+  busClock = u8x8->bus_clock;
+  busConfig.master.clk_speed = busClock;
+  i2c_param_config(DISPLAY_I2C_PORT, &busConfig);
+}
+
+extern "C" uint8_t u8x8_byte_idf_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+  switch (msg) {
+    case U8X8_MSG_BYTE_INIT:
+      if (u8x8->bus_clock == 0) {
+        u8x8->bus_clock = u8x8->display_info->i2c_bus_clock_100kHz * 100000UL;
+      }
+      busConfig.mode = I2C_MODE_MASTER;
+      busConfig.sda_io_num = u8x8->pins[U8X8_PIN_I2C_DATA];
+      busConfig.scl_io_num = u8x8->pins[U8X8_PIN_I2C_CLOCK];
+      busConfig.sda_pullup_en = GPIO_PULLUP_ENABLE;
+      busConfig.scl_pullup_en = GPIO_PULLUP_ENABLE;
+      busConfig.master.clk_speed = u8x8->bus_clock;
+      busClock = u8x8->bus_clock;
+      installDriver();
+      break;
+    case U8X8_MSG_BYTE_SET_DC:
+      break;
+    case U8X8_MSG_BYTE_START_TRANSFER:
+      applyClock(u8x8);
+      transferLength = 0;
+      transferOverflow = false;
+      break;
+    case U8X8_MSG_BYTE_SEND:
+      if (transferLength + arg_int > sizeof(transfer)) {
+        transferOverflow = true;
+        break;
+      }
+      memcpy(transfer + transferLength, arg_ptr, arg_int);
+      transferLength += arg_int;
+      break;
+    case U8X8_MSG_BYTE_END_TRANSFER: {
+      if (transferOverflow) {
+        busStats.errors++;
+        break;
+      }
+      if (transferLength == 0) {
+        break;
+      }
+      if (stuck) {
+        busStats.skipped++;
+        break;
+      }
+      unsigned long start = micros();
+      esp_err_t err = i2c_master_write_to_device(DISPLAY_I2C_PORT, u8x8_GetI2CAddress(u8x8) >> 1, transfer,
+                                                 transferLength, pdMS_TO_TICKS(DISPLAY_I2C_TIMEOUT_MS));
+      uint32_t elapsed = micros() - start;
+      busStats.busyUs += elapsed;
+      busStats.transactions++;
+      busStats.bytes += transferLength;
+      if (err == ESP_OK) {
+        errorRun = 0;
+        break;
+      }
+      busStats.lostUs += elapsed;
+      if (err == ESP_FAIL) {
+        busStats.nacks++;
+      } else if (err == ESP_ERR_TIMEOUT) {
+        busStats.timeouts++;
+      } else {
+        busStats.errors++;
+      }
+      if (!linesHigh()) {
+        // Not the clock's fault, don't let it count towards a fallback
+        stuck = true;
+        stuckSinceMs = millis();
+        retryAtMs = stuckSinceMs;
+        retryMs = DISPLAY_BUS_RETRY_MS;
+        busStats.stuck++;
+      } else if (errorRun < 255) {
+        errorRun++;
+      }
+      break;
+    }
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+static bool inData = false;
+static uint16_t pending = 0;
+
+static void restartTransfer(u8x8_t* u8x8) {
+  u8x8_byte_EndTransfer(u8x8);
+  u8x8_byte_StartTransfer(u8x8);
+  inData = false;
+  pending = 0;
+}
+
+extern "C" uint8_t u8x8_cad_sh1106_page_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr) {
+  switch (msg) {
+    case U8X8_MSG_CAD_INIT:
+      return u8x8->byte_cb(u8x8, U8X8_MSG_BYTE_INIT, arg_int, arg_ptr);
+    case U8X8_MSG_CAD_START_TRANSFER:
+      inData = false;
+      pending = 0;
+      return u8x8_byte_StartTransfer(u8x8);
+    case U8X8_MSG_CAD_SEND_CMD:
+    case U8X8_MSG_CAD_SEND_ARG:
+      // No commands after data in the same transaction
+      if (inData || pending + 2 > DISPLAY_I2C_MAX_TRANSFER) {
+        restartTransfer(u8x8);
+      }
+      u8x8_byte_SendByte(u8x8, CONTROL_COMMAND);
+      u8x8_byte_SendByte(u8x8, arg_int);
+      pending += 2;
+      break;
+    case U8X8_MSG_CAD_SEND_DATA:
+      if (pending + arg_int + (inData ? 0 : 1) > DISPLAY_I2C_MAX_TRANSFER) {
+        restartTransfer(u8x8);
+      }
+      if (!inData) {
+        u8x8_byte_SendByte(u8x8, CONTROL_DATA);
+        pending++;
+        inData = true;
+      }
+      u8x8_byte_SendBytes(u8x8, arg_int, (uint8_t*)arg_ptr);
+      pending += arg_int;
+      break;
+    case U8X8_MSG_CAD_END_TRANSFER:
+      return u8x8_byte_EndTransfer(u8x8);
+    default:
+      return 0;
+  }
+  return 1;
+}
+
+// SH1106 RAM is 132 columns wide and the panel shows 2..129
+#define TEST_COLUMN 130
+
+// Pattern in both hidden columns of a page, then reads it back. The first
+// byte read after setting the address is a dummy.
+static bool testPage(uint8_t address, uint8_t page, uint8_t a, uint8_t b, bool read) {
+  TickType_t timeout = pdMS_TO_TICKS(DISPLAY_I2C_TIMEOUT_MS);
+  uint8_t position[] = {
+    CONTROL_COMMAND, (uint8_t)(0xb0 | page),
+    CONTROL_COMMAND, (uint8_t)(0x10 | (TEST_COLUMN >> 4)),
+    CONTROL_COMMAND, (uint8_t)(TEST_COLUMN & 0x0f),
+  };
+  uint8_t write[sizeof(position) + 3];
+  memcpy(write, position, sizeof(position));
+  write[sizeof(position)] = CONTROL_DATA;
+  write[sizeof(position) + 1] = a;
+  write[sizeof(position) + 2] = b;
+  if (i2c_master_write_to_device(DISPLAY_I2C_PORT, address, write, sizeof(write), timeout) != ESP_OK) {
+    return false;
+  }
+  if (!read) {
+    return true;
+  }
+
+  uint8_t readData = CONTROL_DATA;
+  uint8_t back[3];
+  return i2c_master_write_to_device(DISPLAY_I2C_PORT, address, position, sizeof(position), timeout) == ESP_OK &&
+         i2c_master_write_read_device(DISPLAY_I2C_PORT, address, &readData, 1, back, sizeof(back), timeout) == ESP_OK &&
+         back[1] == a && back[2] == b;
+}
+
+static bool testClock(u8x8_t* u8x8, uint32_t hz, bool read) {
+  u8x8->bus_clock = hz;
+  applyClock(u8x8);
+  uint8_t address = u8x8_GetI2CAddress(u8x8) >> 1;
+  for (uint8_t round = 0; round < DISPLAY_BUS_TEST_ROUNDS; round++) {
+    for (uint8_t page = 0; page < 8; page++) {
+      // Alternating bits plus a few that change every round and page
+      uint8_t a = 0xa5 ^ (uint8_t)(round * 29 + page * 7);
+      if (!testPage(address, page, a, ~a, read)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool displayBusTest(U8G2& display, uint32_t hz) {
+  u8x8_t* u8x8 = display.getU8x8();
+  if (canRead < 0) {
+    // Decided at the slowest clock, where a mismatch means the panel can't be read
+    canRead = testClock(u8x8, DISPLAY_BUS_MIN_HZ, true) ? 1 : 0;
+  }
+  return testClock(u8x8, hz, canRead > 0);
+}
+
+uint32_t displayBusTune(U8G2& display) {
+  uint32_t best = 0;
+  for (uint8_t i = 0; i < CLOCK_STEP_COUNT; i++) {
+    if (!displayBusTest(display, CLOCK_STEPS[i])) {
+      break;
+    }
+    best = CLOCK_STEPS[i];
+  }
+  // Nothing answered, keep the rated clock and let the counters show it
+  return best ? best : DISPLAY_BUS_HZ;
+}
+
+void displayBusSetClock(U8G2& display, uint32_t hz) {
+  tunedClock = hz;
+  errorRun = 0;
+  display.setBusClock(hz);
+}
+
+// Just the address, at the slowest clock. The display's own clock goes back
+// on with its next transfer.
+static bool panelAnswers(uint8_t address) {
+  busClock = DISPLAY_BUS_MIN_HZ;
+  busConfig.master.clk_speed = busClock;
+  i2c_param_config(DISPLAY_I2C_PORT, &busConfig);
+
+  i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+  i2c_master_start(cmd);
+  i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
+  i2c_master_stop(cmd);
+  esp_err_t err = i2c_master_cmd_begin(DISPLAY_I2C_PORT, cmd, pdMS_TO_TICKS(DISPLAY_I2C_TIMEOUT_MS));
+  i2c_cmd_link_delete(cmd);
+  return err == ESP_OK;
+}
+
+uint32_t displayBusCheck(U8G2& display) {
+  if (stuck || errorRun < DISPLAY_BUS_FALLBACK_ERRORS || tunedClock <= DISPLAY_BUS_MIN_HZ) {
+    return 0;
+  }
+  if (!panelAnswers(u8x8_GetI2CAddress(display.getU8x8()) >> 1)) {
+    // Unplugged or without power, a slower clock won't bring it back
+    busStats.absent++;
+    errorRun = 0;
+    return 0;
+  }
+  uint32_t lower = DISPLAY_BUS_MIN_HZ;
+  for (uint8_t i = 0; i < CLOCK_STEP_COUNT; i++) {
+    if (CLOCK_STEPS[i] < tunedClock) {
+      lower = CLOCK_STEPS[i];
+    }
+  }
+  busStats.fallbacks++;
+  displayBusSetClock(display, lower);
+  return lower;
+}
+
+// Up to nine clocks let a device finish the byte it thinks it is sending
+// and release SDA, then a stop condition resets every device's state
+static bool clearBus() {
+  uint8_t sda = busConfig.sda_io_num;
+  uint8_t scl = busConfig.scl_io_num;
+  pinMode(sda, INPUT_PULLUP);
+  pinMode(scl, OUTPUT_OPEN_DRAIN);
+  digitalWrite(scl, HIGH);
+  delayMicroseconds(5);
+  for (uint8_t i = 0; i < 9 && digitalRead(sda) == LOW; i++) {
+    digitalWrite(scl, LOW);
+    delayMicroseconds(5);
+    digitalWrite(scl, HIGH);
+    delayMicroseconds(5);
+  }
+  if (digitalRead(scl) == LOW || digitalRead(sda) == LOW) {
+    return false;
+  }
+
+  pinMode(sda, OUTPUT_OPEN_DRAIN);
+  digitalWrite(sda, LOW);
+  delayMicroseconds(5);
+  digitalWrite(sda, HIGH);
+  delayMicroseconds(5);
+  return true;
+}
+
+bool displayBusRecover(U8G2& display, unsigned long nowMs) {
+  if (!stuck || (long)(nowMs - retryAtMs) < 0) {
+    return false;
+  }
+
+  // A transfer failing during the re-init marks the bus stuck again
+  unsigned long since = stuckSinceMs;
+  uint16_t wait = retryMs;
+  unsigned long start = micros();
+  i2c_driver_delete(DISPLAY_I2C_PORT);
+  bool clear = clearBus();
+  installDriver();
+  if (clear) {
+    // The panel may have reset too, or latched a half command
+    stuck = false;
+    errorRun = 0;
+    display.initDisplay();
+    display.setPowerSave(0);
+  }
+  busStats.lostUs += micros() - start;
+
+  if (stuck) {
+    busStats.recoveryFailures++;
+    stuckSinceMs = since;
+    retryAtMs = nowMs + wait;
+    retryMs = wait * 2 > DISPLAY_BUS_RETRY_MAX_MS ? DISPLAY_BUS_RETRY_MAX_MS : wait * 2;
+    return false;
+  }
+  busStats.recoveries++;
+  busStats.downMs += nowMs - stuckSinceMs;
+  return true;
+}
@@ -0,0 +1,104 @@
+// SH1106 over the ESP-IDF I2C driver
+// U8g2's Arduino transport goes through Wire, and its SSD13xx I2C layer ends
+// the transaction every 24 data bytes: a 128 byte page takes six data
+// transactions plus one for its commands, each with its own start, address
+// and stop. Here the command/data layer (cad) prefixes every command with a
+// continuation control byte (0x80) and switches to data with 0x40, so the
+// page commands and all 128 bytes fit in one transaction, and the byte layer
+// collects everything between start and end of a transfer and writes it
+// with a single i2c_master_write_to_device() call.
+// The clock is tuned at boot: displayBusTune() steps it up while the panel
+// passes displayBusTest(), and displayBusCheck() steps it back down for the
+// rest of the session when transfers keep failing while the panel still
+// answers its address, for clone modules that are marginal.
+// A failed transfer that leaves SDA or SCL held low (ESD, a loose cable)
+// stops all transfers instead of timing out on every page, and
+// displayBusRecover() clocks the bus free and re-inits the panel from
+// loop(), one bounded attempt at a time.
+// Build with -DDISPLAY_WIRE_I2C to go back to the Wire transport.
+
+#ifndef DISPLAY_I2C_H
+#define DISPLAY_I2C_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+#define DISPLAY_SDA_PIN 21
+#define DISPLAY_SCL_PIN 22
+
+// SH1106 rated clock, used until tuned
+#define DISPLAY_BUS_HZ 400000
+// Slowest clock, tuning and fallbacks never go below it
+#define DISPLAY_BUS_MIN_HZ 100000
+// Test patterns written and read back per clock step
+#define DISPLAY_BUS_TEST_ROUNDS 16
+// Failed transfers in a row that make displayBusCheck() step down
+#define DISPLAY_BUS_FALLBACK_ERRORS 3
+
+// Largest transaction: page commands plus a 255 byte data block
+#define DISPLAY_I2C_MAX_TRANSFER 272
+#define DISPLAY_I2C_TIMEOUT_MS 20
+
+// Recovery attempts start right away and back off up to the maximum while
+// the bus stays stuck
+#define DISPLAY_BUS_RETRY_MS 50
+#define DISPLAY_BUS_RETRY_MAX_MS 2000
+
+struct DisplayBusStats {
+  uint32_t transactions;
+  uint32_t bytes;        // Including control bytes, without the address
+  uint32_t busyUs;       // Time spent in the driver
+  uint32_t nacks;
+  uint32_t timeouts;
+  uint32_t errors;       // Other driver errors and oversized transfers
+  uint32_t fallbacks;    // Clock steps down by displayBusCheck()
+  uint32_t absent;       // Error runs with no answer at the address, not counted as fallbacks
+  uint32_t stuck;        // Times a failed transfer left a line held low
+  uint32_t recoveries;
+  uint32_t recoveryFailures;  // Attempts that didn't free the bus
+  uint32_t skipped;      // Transfers dropped while the bus was stuck
+  uint32_t lostUs;       // In failed transfers and recovery attempts
+  uint32_t downMs;       // Screen frozen, from getting stuck to recovered
+};
+
+extern "C" uint8_t u8x8_byte_idf_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+extern "C" uint8_t u8x8_cad_sh1106_page_i2c(u8x8_t* u8x8, uint8_t msg, uint8_t arg_int, void* arg_ptr);
+
+const DisplayBusStats& displayBusStats();
+void displayBusResetStats();
+
+// Writes test patterns to the two columns the SH1106 has beyond the 128
+// visible ones and reads them back at `hz`. Panels that can't be read over
+// I2C are only checked for ACKs. Leaves the clock at `hz`.
+bool displayBusTest(U8G2& display, uint32_t hz);
+// Steps up through the clocks while displayBusTest() passes, returns the
+// fastest one that did
+uint32_t displayBusTune(U8G2& display);
+// Runs the display at `hz` from now on and clears the error run
+void displayBusSetClock(U8G2& display, uint32_t hz);
+uint32_t displayBusClock();
+bool displayBusCanRead();
+// Call regularly. After DISPLAY_BUS_FALLBACK_ERRORS failed transfers in a
+// row it checks that the panel ACKs its address at the slowest clock, then
+// steps the clock down and returns the new one, otherwise 0.
+uint32_t displayBusCheck(U8G2& display);
+
+// Call from loop(). While the bus is stuck, pulses SCL until the device
+// holding SDA lets go, reinstalls the driver and re-inits the panel, at
+// most once per retry interval. Returns true once recovered: the panel is
+// blank and on, and needs its contrast and a full frame again.
+bool displayBusRecover(U8G2& display, unsigned long nowMs);
+bool displayBusStuck();
+
+class U8G2_SH1106_128X64_NONAME_F_IDF_I2C : public U8G2 {
+public:
+  U8G2_SH1106_128X64_NONAME_F_IDF_I2C(const u8g2_cb_t* rotation, uint8_t reset = U8X8_PIN_NONE,
+                                      uint8_t clock = U8X8_PIN_NONE, uint8_t data = U8X8_PIN_NONE)
+      : U8G2() {
+    u8g2_Setup_sh1106_i2c_128x64_noname_f(&u8g2, rotation, u8x8_byte_idf_i2c, u8x8_gpio_and_delay_arduino);
+    getU8x8()->cad_cb = u8x8_cad_sh1106_page_i2c;
+    u8x8_SetPin_HW_I2C(getU8x8(), reset, clock, data);
+  }
+};
+
+#endif
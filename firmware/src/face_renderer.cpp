@@ -0,0 +1,443 @@
+#include "face_renderer.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "host/host_time.h"
+#endif
+#include <math.h>
+#include <string.h>
+
+// Thinnest an eye gets, closed eyes are a curved line instead of nothing
+#define FACE_MIN_EYE_PX 2
+
+static const int16_t NEUTRAL[FACE_PARAM_COUNT] = {
+  44,   // FACE_SPACING
+  30,   // FACE_EYE_Y
+  22,   // FACE_WIDTH
+  30,   // FACE_HEIGHT
+  100,  // FACE_OPEN_LEFT
+  100,  // FACE_OPEN_RIGHT
+  0,    // FACE_TILT
+  0,    // FACE_LOOK_X
+  0,    // FACE_LOOK_Y
+  0,    // FACE_PUPIL
+  0,    // FACE_HAPPY
+};
+
+// Built-in expressions. Names must not collide with pack clips, those win.
+
+// Looks left and right, then blinks
+static const FaceKey EYES_LOOK[] = {
+  {0, 0, FACE_EASE_LINEAR}, {600, 0, FACE_EASE_LINEAR}, {900, -10, FACE_EASE_IN_OUT},
+  {1700, -10, FACE_EASE_LINEAR}, {2100, 10, FACE_EASE_IN_OUT}, {2800, 10, FACE_EASE_LINEAR},
+  {3100, 0, FACE_EASE_IN_OUT},
+};
+static const FaceKey EYES_BLINK[] = {
+  {0, 100, FACE_EASE_LINEAR}, {3300, 100, FACE_EASE_LINEAR}, {3400, 0, FACE_EASE_IN},
+  {3520, 100, FACE_EASE_OUT},
+};
+static const FaceTrack EYES_TRACKS[] = {
+  {FACE_LOOK_X, 7, EYES_LOOK},
+  {FACE_OPEN_LEFT, 4, EYES_BLINK},
+  {FACE_OPEN_RIGHT, 4, EYES_BLINK},
+};
+
+static const FaceKey BLINK_OPEN[] = {
+  {0, 100, FACE_EASE_LINEAR}, {100, 0, FACE_EASE_IN}, {250, 100, FACE_EASE_OUT},
+};
+static const FaceTrack BLINK_TRACKS[] = {
+  {FACE_OPEN_LEFT, 3, BLINK_OPEN},
+  {FACE_OPEN_RIGHT, 3, BLINK_OPEN},
+};
+
+static const FaceTrack WINK_TRACKS[] = {
+  {FACE_OPEN_RIGHT, 3, BLINK_OPEN},
+};
+
+static const FaceKey HAPPY_SMILE[] = {
+  {0, 0, FACE_EASE_LINEAR}, {400, 70, FACE_EASE_OUT}, {2200, 70, FACE_EASE_LINEAR},
+  {2600, 0, FACE_EASE_IN_OUT},
+};
+static const FaceKey HAPPY_RAISE[] = {
+  {0, 30, FACE_EASE_LINEAR}, {400, 27, FACE_EASE_OUT}, {2200, 27, FACE_EASE_LINEAR},
+  {2600, 30, FACE_EASE_IN_OUT},
+};
+static const FaceTrack HAPPY_TRACKS[] = {
+  {FACE_HAPPY, 4, HAPPY_SMILE},
+  {FACE_EYE_Y, 4, HAPPY_RAISE},
+};
+
+// Lids droop, nearly close and catch themselves
+static const FaceKey SLEEPY_OPEN[] = {
+  {0, 40, FACE_EASE_LINEAR}, {1500, 30, FACE_EASE_IN_OUT}, {3000, 8, FACE_EASE_IN},
+  {3300, 45, FACE_EASE_OUT}, {5000, 40, FACE_EASE_IN_OUT},
+};
+static const FaceKey SLEEPY_LOOK[] = {
+  {0, 2, FACE_EASE_LINEAR}, {3000, 5, FACE_EASE_IN}, {3300, 1, FACE_EASE_OUT},
+  {5000, 2, FACE_EASE_IN_OUT},
+};
+static const FaceTrack SLEEPY_TRACKS[] = {
+  {FACE_OPEN_LEFT, 5, SLEEPY_OPEN},
+  {FACE_OPEN_RIGHT, 5, SLEEPY_OPEN},
+  {FACE_LOOK_Y, 4, SLEEPY_LOOK},
+};
+
+static const FaceKey SUSPICIOUS_LEFT[] = {{0, 45, FACE_EASE_LINEAR}};
+static const FaceKey SUSPICIOUS_RIGHT[] = {{0, 60, FACE_EASE_LINEAR}};
+static const FaceKey SUSPICIOUS_LOOK[] = {
+  {0, 0, FACE_EASE_LINEAR}, {500, 9, FACE_EASE_IN_OUT}, {2000, 9, FACE_EASE_LINEAR},
+  {2500, -9, FACE_EASE_IN_OUT}, {4000, -9, FACE_EASE_LINEAR}, {4500, 0, FACE_EASE_IN_OUT},
+};
+static const FaceTrack SUSPICIOUS_TRACKS[] = {
+  {FACE_OPEN_LEFT, 1, SUSPICIOUS_LEFT},
+  {FACE_OPEN_RIGHT, 1, SUSPICIOUS_RIGHT},
+  {FACE_LOOK_X, 6, SUSPICIOUS_LOOK},
+};
+
+static const FaceKey MAD_TILT[] = {{0, 0, FACE_EASE_LINEAR}, {250, 9, FACE_EASE_OUT}};
+static const FaceKey MAD_OPEN[] = {{0, 100, FACE_EASE_LINEAR}, {250, 70, FACE_EASE_OUT}};
+static const FaceTrack MAD_TRACKS[] = {
+  {FACE_TILT, 2, MAD_TILT},
+  {FACE_OPEN_LEFT, 2, MAD_OPEN},
+  {FACE_OPEN_RIGHT, 2, MAD_OPEN},
+};
+
+// Angry: mad eyes plus brows and the anger mark from the old angry_bitmap.h
+// frame. The brow masks are one pixel wider than the brows, so they cut a
+// gap where they overlap the lids.
+// 20x18, cut from angry_bitmap.h
+static const uint8_t ANGER_MARK_BITS[] = {
+  0x60, 0xe0, 0xe0, 0xc0, 0xc0, 0xfe, 0x7f, 0x3f, 0x00, 0x00, 0x00, 0xfc,
+  0xfe, 0xfe, 0xc0, 0xc0, 0xc0, 0x80, 0x00, 0x00, 0x18, 0x1c, 0x1c, 0xb9,
+  0xf9, 0xf0, 0x00, 0x00, 0x00, 0xc0, 0xe0, 0xf0, 0x70, 0x39, 0x39, 0x39,
+  0x31, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0x03, 0x00, 0x00,
+  0x00, 0x01, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+// 18x9
+static const uint8_t BROW_LEFT_BITS[] = {
+  0x03, 0x07, 0x07, 0x0e, 0x0e, 0x1e, 0x1c, 0x3c, 0x38, 0x78, 0x70, 0xf0,
+  0xe0, 0xe0, 0xc0, 0xc0, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01,
+};
+static const uint8_t BROW_LEFT_MASK[] = {
+  0x0f, 0x0f, 0x1f, 0x1f, 0x3f, 0x3f, 0x7f, 0x7e, 0xfe, 0xfc, 0xfc, 0xf8,
+  0xf8, 0xf0, 0xf0, 0xe0, 0xe0, 0xc0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+};
+static const uint8_t BROW_RIGHT_BITS[] = {
+  0x80, 0x80, 0xc0, 0xc0, 0xe0, 0xe0, 0xf0, 0x70, 0x78, 0x38, 0x3c, 0x1c,
+  0x1e, 0x0e, 0x0e, 0x07, 0x07, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+static const uint8_t BROW_RIGHT_MASK[] = {
+  0xc0, 0xe0, 0xe0, 0xf0, 0xf0, 0xf8, 0xf8, 0xfc, 0xfc, 0xfe, 0x7e, 0x7f,
+  0x3f, 0x3f, 0x1f, 0x1f, 0x0f, 0x0f, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const Sprite ANGER_MARK = {20, 18, ANGER_MARK_BITS, nullptr};
+static const Sprite BROW_LEFT = {18, 9, BROW_LEFT_BITS, BROW_LEFT_MASK};
+static const Sprite BROW_RIGHT = {18, 9, BROW_RIGHT_BITS, BROW_RIGHT_MASK};
+
+static const Sprite* const SPRITES[FACE_SPRITE_COUNT] = {&ANGER_MARK, &BROW_LEFT, &BROW_RIGHT};
+
+const Sprite* faceSprite(uint8_t id) {
+  return id < FACE_SPRITE_COUNT ? SPRITES[id] : nullptr;
+}
+
+static const FaceLayer ANGRY_LAYERS[] = {
+  {&BROW_LEFT, FACE_ANCHOR_LEFT_EYE, -10, -14, SPRITE_MASK},
+  {&BROW_RIGHT, FACE_ANCHOR_RIGHT_EYE, -7, -14, SPRITE_MASK},
+  {&ANGER_MARK, FACE_ANCHOR_SCREEN, 100, 2, SPRITE_OR},
+};
+
+#define TRACKS(t) sizeof(t) / sizeof(t[0]), t
+#define LAYERS(l) sizeof(l) / sizeof(l[0]), l
+
+static const FaceExpression EXPRESSIONS[] = {
+  {"eyes", 4000, true, TRACKS(EYES_TRACKS), 0, nullptr},
+  {"blink", 250, false, TRACKS(BLINK_TRACKS), 0, nullptr},
+  {"wink", 250, false, TRACKS(WINK_TRACKS), 0, nullptr},
+  {"happy", 2600, false, TRACKS(HAPPY_TRACKS), 0, nullptr},
+  {"sleepy", 5000, true, TRACKS(SLEEPY_TRACKS), 0, nullptr},
+  {"suspicious", 4500, true, TRACKS(SUSPICIOUS_TRACKS), 0, nullptr},
+  {"mad", 2000, false, TRACKS(MAD_TRACKS), 0, nullptr},
+  {"angry", 2000, false, TRACKS(MAD_TRACKS), LAYERS(ANGRY_LAYERS)},
+};
+
+const FaceExpression* faceFindExpression(const char* name) {
+  for (size_t i = 0; i < sizeof(EXPRESSIONS) / sizeof(EXPRESSIONS[0]); i++) {
+    if (strcmp(EXPRESSIONS[i].name, name) == 0) {
+      return &EXPRESSIONS[i];
+    }
+  }
+  return nullptr;
+}
+
+void faceNeutral(FaceParams* params) {
+  for (int i = 0; i < FACE_PARAM_COUNT; i++) {
+    params->values[i] = NEUTRAL[i];
+  }
+}
+
+// Bits y0..y1 of a 64 pixel column
+static inline uint64_t columnMask(int y0, int y1) {
+  return (~0ULL << y0) & (~0ULL >> (63 - y1));
+}
+
+// ORs (or clears) one vertical span into the pages it touches
+static inline void fillColumn(uint8_t* frame, int x, int y0, int y1, bool set) {
+  if (x < 0 || x >= ANIM_FRAME_WIDTH) {
+    return;
+  }
+  if (y0 < 0) {
+    y0 = 0;
+  }
+  if (y1 > ANIM_FRAME_HEIGHT - 1) {
+    y1 = ANIM_FRAME_HEIGHT - 1;
+  }
+  if (y0 > y1) {
+    return;
+  }
+
+  uint64_t mask = columnMask(y0, y1);
+  uint8_t* column = frame + x;
+  for (int page = y0 >> 3; page <= y1 >> 3; page++) {
+    uint8_t bits = (uint8_t)(mask >> (page * 8));
+    if (set) {
+      column[page * ANIM_FRAME_WIDTH] |= bits;
+    } else {
+      column[page * ANIM_FRAME_WIDTH] &= ~bits;
+    }
+  }
+}
+
+// One eye, `side` is +1 for the left eye and -1 for the right so tilt mirrors
+static void drawEye(uint8_t* frame, const float* v, float cx, float open, float side) {
+  float cy = v[FACE_EYE_Y] + v[FACE_LOOK_Y];
+  float rx = v[FACE_WIDTH] * 0.5f;
+  float ry = v[FACE_HEIGHT] * 0.5f;
+  float happy = v[FACE_HAPPY] * 0.01f;
+  open = open < 0 ? 0 : (open > 1 ? 1 : open);
+  if (rx < 1 || ry < 1) {
+    return;
+  }
+
+  int x0 = (int)ceilf(cx - rx);
+  int x1 = (int)floorf(cx + rx);
+  for (int x = x0; x <= x1; x++) {
+    float dx = (x - cx) / rx;
+    float d2 = dx * dx;
+    if (d2 > 1) {
+      continue;
+    }
+    float h = ry * sqrtf(1 - d2);
+    float top = cy - h;
+    float bottom = cy + h;
+
+    // Upper lid comes down as the eye closes, tilt lowers the inner corner
+    float lid = cy - ry + 2 * ry * (1 - open) + v[FACE_TILT] * dx * side;
+    if (lid > top) {
+      top = lid;
+    }
+    // Lower lid arcs up in the middle for ^ ^ eyes
+    float lower = cy + ry - happy * ry * 1.5f * (1 - d2);
+    if (lower < bottom) {
+      bottom = lower;
+    }
+    if (bottom - top < FACE_MIN_EYE_PX) {
+      // Closed: keep the lash line along the lower half only
+      if (bottom < cy + ry * 0.5f) {
+        continue;
+      }
+      top = bottom - FACE_MIN_EYE_PX;
+    }
+
+    fillColumn(frame, x, lroundf(top), lroundf(bottom), true);
+  }
+
+  float pupil = v[FACE_PUPIL];
+  if (pupil < 1) {
+    return;
+  }
+  // Pupils lead the gaze a little further than the eyes do
+  float px = cx + v[FACE_LOOK_X] * 0.4f;
+  float py = cy + v[FACE_LOOK_Y] * 0.4f;
+  for (int x = (int)ceilf(px - pupil); x <= (int)floorf(px + pupil); x++) {
+    float dx = (x - px) / pupil;
+    float h = pupil * sqrtf(fmaxf(0, 1 - dx * dx));
+    fillColumn(frame, x, lroundf(py - h), lroundf(py + h), false);
+  }
+}
+
+void faceRender(const FaceParams& params, uint8_t* frame, const FaceLayer* layers, uint8_t layerCount) {
+  memset(frame, 0, ANIM_FRAME_BYTES);
+  faceDraw(params, frame, layers, layerCount);
+}
+
+// The grown render, the other two go straight into the planes
+alignas(4) static uint8_t grayGrown[ANIM_FRAME_BYTES];
+
+void faceRenderGray(const FaceParams& params, uint8_t* msb, uint8_t* lsb, const FaceLayer* layers,
+                    uint8_t layerCount) {
+  FaceParams sized = params;
+  sized.values[FACE_WIDTH] = params.values[FACE_WIDTH] - 2 * FACE_GRAY_EDGE_PX;
+  sized.values[FACE_HEIGHT] = params.values[FACE_HEIGHT] - 2 * FACE_GRAY_EDGE_PX;
+  faceRender(sized, lsb, layers, layerCount);
+  faceRender(params, msb, layers, layerCount);
+  sized.values[FACE_WIDTH] = params.values[FACE_WIDTH] + 2 * FACE_GRAY_EDGE_PX;
+  sized.values[FACE_HEIGHT] = params.values[FACE_HEIGHT] + 2 * FACE_GRAY_EDGE_PX;
+  faceRender(sized, grayGrown, layers, layerCount);
+
+  // Count of the three renders as a 2 bit number: the MSB is set in at least
+  // two of them, the LSB in an odd number
+  uint32_t* high = (uint32_t*)msb;
+  uint32_t* low = (uint32_t*)lsb;
+  const uint32_t* grown = (const uint32_t*)grayGrown;
+  for (int i = 0; i < ANIM_FRAME_BYTES / 4; i++) {
+    uint32_t a = low[i];
+    uint32_t b = high[i];
+    uint32_t c = grown[i];
+    high[i] = (a & b) | (a & c) | (b & c);
+    low[i] = a ^ b ^ c;
+  }
+}
+
+void faceDraw(const FaceParams& params, uint8_t* frame, const FaceLayer* layers, uint8_t layerCount) {
+  const float* v = params.values;
+  float center = ANIM_FRAME_WIDTH / 2 + v[FACE_LOOK_X];
+  float half = v[FACE_SPACING] * 0.5f;
+  drawEye(frame, v, center - half, v[FACE_OPEN_LEFT] * 0.01f, 1);
+  drawEye(frame, v, center + half, v[FACE_OPEN_RIGHT] * 0.01f, -1);
+
+  int eyeY = lroundf(v[FACE_EYE_Y] + v[FACE_LOOK_Y]);
+  for (uint8_t i = 0; i < layerCount; i++) {
+    const FaceLayer& layer = layers[i];
+    int x = layer.x;
+    int y = layer.y;
+    if (layer.anchor != FACE_ANCHOR_SCREEN) {
+      x += lroundf(layer.anchor == FACE_ANCHOR_LEFT_EYE ? center - half : center + half);
+      y += eyeY;
+    }
+    if (layer.sprite) {
+      spriteDraw(frame, *layer.sprite, x, y, layer.blend);
+    }
+  }
+}
+
+float faceEase(uint8_t kind, float t) {
+  switch (kind) {
+    case FACE_EASE_IN:
+      return t * t;
+    case FACE_EASE_OUT:
+      return t * (2 - t);
+    case FACE_EASE_IN_OUT:
+      return t < 0.5f ? 2 * t * t : -1 + (4 - 2 * t) * t;
+    case FACE_EASE_STEP:
+      return t < 1 ? 0 : 1;
+    default:
+      return t;
+  }
+}
+
+static float trackValue(const FaceTrack& track, uint32_t timeMs) {
+  const FaceKey* keys = track.keys;
+  if (timeMs <= keys[0].timeMs) {
+    return keys[0].value;
+  }
+  for (uint8_t i = 1; i < track.keyCount; i++) {
+    if (timeMs < keys[i].timeMs) {
+      const FaceKey& from = keys[i - 1];
+      const FaceKey& to = keys[i];
+      float t = (float)(timeMs - from.timeMs) / (to.timeMs - from.timeMs);
+      return from.value + (to.value - from.value) * faceEase(to.ease, t);
+    }
+  }
+  return keys[track.keyCount - 1].value;
+}
+
+void FacePlayer::evaluate(uint32_t timeMs, FaceParams* out) const {
+  faceNeutral(out);
+  for (uint8_t i = 0; i < expression->trackCount; i++) {
+    const FaceTrack& track = expression->tracks[i];
+    if (track.param < FACE_PARAM_COUNT && track.keyCount > 0) {
+      out->values[track.param] = trackValue(track, timeMs);
+    }
+  }
+}
+
+bool FacePlayer::play(const char* name) {
+  const FaceExpression* found = faceFindExpression(name);
+  play(found);
+  return found != nullptr;
+}
+
+// Takes effect with the next frame, a finished expression renders it once more
+void FacePlayer::setGray(bool enabled) {
+  if (enabled == gray) {
+    return;
+  }
+  gray = enabled;
+  if (expression && done) {
+    done = false;
+  }
+}
+
+void FacePlayer::play(const FaceExpression* newExpression) {
+  expression = newExpression;
+  started = false;
+  done = expression == nullptr;
+}
+
+bool FacePlayer::isPlaying(const char* name) const {
+  return expression && strcmp(expression->name, name) == 0;
+}
+
+bool FacePlayer::update(unsigned long nowMs) {
+  if (!expression || done) {
+    return false;
+  }
+  if (!started) {
+    startTime = nowMs;
+    started = true;
+  } else if (nowMs - lastFrameTime < FACE_FRAME_MS) {
+    return false;
+  }
+  lastFrameTime = nowMs;
+
+  uint32_t elapsed = nowMs - startTime;
+  if (elapsed >= expression->durationMs) {
+    if (expression->loop && expression->durationMs > 0) {
+      elapsed %= expression->durationMs;
+    } else {
+      elapsed = expression->durationMs;
+      done = true;
+    }
+  }
+
+  unsigned long start = micros();
+  evaluate(elapsed, &current);
+  if (gray) {
+    faceRenderGray(current, frameBuffer, grayBuffer, expression->layers, expression->layerCount);
+  } else {
+    faceRender(current, frameBuffer, expression->layers, expression->layerCount);
+  }
+  uint32_t renderUs = micros() - start;
+
+  if (perf.framesRendered == 0) {
+    perf.windowStartMs = nowMs;
+  }
+  perf.framesRendered++;
+  perf.lastRenderUs = renderUs;
+  perf.totalRenderUs += renderUs;
+  if (renderUs > perf.maxRenderUs) {
+    perf.maxRenderUs = renderUs;
+  }
+  perf.lastFrameMs = nowMs;
+  return true;
+}
+
+void FacePlayer::resetStats() {
+  perf = {};
+}
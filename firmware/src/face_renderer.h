@@ -0,0 +1,162 @@
+// Procedural eyes
+// Draws the two eyes from a handful of parameters straight into a page-
+// format frame (see anim_pack.h): every column of an eye is one vertical
+// span, turned into a 64 bit column mask and OR'd into the page bytes it
+// touches. Expressions are keyframed parameter tracks - a few bytes per
+// key instead of a kilobyte per frame. Brows and other accessories are
+// sprites (sprite.h) layered over the eyes.
+// For grayscale (gray.h) the eyes are rendered three times, shrunk, as
+// they are and grown by FACE_GRAY_EDGE_PX, and the number of renders a
+// pixel is set in becomes its 2 bit level, which softens the edges.
+
+#ifndef FACE_RENDERER_H
+#define FACE_RENDERER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "anim_pack.h"
+#include "sprite.h"
+
+// 30 fps - sendBuffer() at 400 kHz takes ~25 ms, that's about the limit
+#define FACE_FRAME_MS 33
+
+// Edges move this far in and out for the three grayscale renders
+#define FACE_GRAY_EDGE_PX 1
+
+enum FaceParam : uint8_t {
+  FACE_SPACING = 0,  // Distance between eye centers, px
+  FACE_EYE_Y,        // Eye center, px from the top
+  FACE_WIDTH,        // Eye width, px
+  FACE_HEIGHT,       // Eye height, px
+  FACE_OPEN_LEFT,    // 0 closed .. 100 open, %
+  FACE_OPEN_RIGHT,
+  FACE_TILT,         // Lid slope, px at the outer edge; positive lowers the inner corners (angry)
+  FACE_LOOK_X,       // Gaze offset, px
+  FACE_LOOK_Y,
+  FACE_PUPIL,        // Pupil radius, px, 0 for solid eyes
+  FACE_HAPPY,        // 0 .. 100 %, lower lid pushed up into a ^ shape
+  FACE_PARAM_COUNT
+};
+
+struct FaceParams {
+  float values[FACE_PARAM_COUNT];
+};
+
+enum FaceEase : uint8_t {
+  FACE_EASE_LINEAR = 0,
+  FACE_EASE_IN,      // Quadratic
+  FACE_EASE_OUT,
+  FACE_EASE_IN_OUT,
+  FACE_EASE_STEP     // Jumps at the key
+};
+
+// Ease applies to the stretch leading up to the key
+struct FaceKey {
+  uint16_t timeMs;
+  int16_t value;
+  uint8_t ease;
+};
+
+struct FaceTrack {
+  uint8_t param;
+  uint8_t keyCount;
+  const FaceKey* keys;
+};
+
+enum FaceAnchor : uint8_t {
+  FACE_ANCHOR_SCREEN = 0,
+  FACE_ANCHOR_LEFT_EYE,   // Eye center, so the sprite follows the gaze
+  FACE_ANCHOR_RIGHT_EYE
+};
+
+// A sprite drawn over the eyes, x/y is its top left corner relative to the anchor
+struct FaceLayer {
+  const Sprite* sprite;
+  uint8_t anchor;
+  int16_t x;
+  int16_t y;
+  uint8_t blend;
+};
+
+// Parameters without a track keep their neutral value
+struct FaceExpression {
+  const char* name;
+  uint16_t durationMs;
+  bool loop;
+  uint8_t trackCount;
+  const FaceTrack* tracks;
+  uint8_t layerCount;
+  const FaceLayer* layers;
+};
+
+// Built-in sprites, ids are also used by scenes (scene.h)
+enum FaceSprite : uint8_t {
+  FACE_SPRITE_ANGER_MARK = 0,
+  FACE_SPRITE_BROW_LEFT,
+  FACE_SPRITE_BROW_RIGHT,
+  FACE_SPRITE_COUNT
+};
+
+void faceNeutral(FaceParams* params);
+// Clears the frame and draws the eyes, layers are composited in order over them
+void faceRender(const FaceParams& params, uint8_t* frame, const FaceLayer* layers = nullptr, uint8_t layerCount = 0);
+// Same without clearing, for drawing the eyes into a frame that has other things in it
+void faceDraw(const FaceParams& params, uint8_t* frame, const FaceLayer* layers = nullptr, uint8_t layerCount = 0);
+// 2 bit version of faceRender() as two 4 byte aligned bit planes, levels are 2 * msb + lsb
+void faceRenderGray(const FaceParams& params, uint8_t* msb, uint8_t* lsb, const FaceLayer* layers = nullptr,
+                    uint8_t layerCount = 0);
+float faceEase(uint8_t kind, float t);
+const Sprite* faceSprite(uint8_t id);
+const FaceExpression* faceFindExpression(const char* name);
+
+struct FacePerfStats {
+  uint32_t framesRendered;
+  uint32_t lastRenderUs;
+  uint32_t maxRenderUs;
+  uint64_t totalRenderUs;
+  // Frame rate actually reached, frames over the window they were rendered in
+  uint32_t windowStartMs;
+  uint32_t lastFrameMs;
+};
+
+// Plays an expression, same shape as AnimPlayer
+class FacePlayer {
+public:
+  bool play(const char* name);
+  void play(const FaceExpression* expression);
+  bool isPlaying(const char* name) const;
+
+  // Renders a new frame every FACE_FRAME_MS, returns true when frame() changed
+  bool update(unsigned long nowMs);
+  bool finished() const { return done; }
+
+  // Grayscale renders frame() as the MSB plane and grayPlane() as the LSB
+  // plane; frame() alone still looks right on a 1 bit display
+  void setGray(bool enabled);
+  bool isGray() const { return gray; }
+
+  const uint8_t* frame() const { return frameBuffer; }
+  const uint8_t* grayPlane() const { return grayBuffer; }
+  const FaceParams& params() const { return current; }
+
+  const FacePerfStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  void evaluate(uint32_t timeMs, FaceParams* out) const;
+
+  const FaceExpression* expression = nullptr;
+  unsigned long startTime = 0;
+  unsigned long lastFrameTime = 0;
+  bool started = false;
+  bool done = false;
+  bool gray = false;
+  FaceParams current;
+
+  alignas(4) uint8_t frameBuffer[ANIM_FRAME_BYTES];
+  alignas(4) uint8_t grayBuffer[ANIM_FRAME_BYTES];
+  FacePerfStats perf = {};
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "flash_cache.h"
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+
+#include "anim_player.h"
+
+static const size_t FLASH_CACHE_BYTES = 32 * 1024;
+static const size_t FLASH_CACHE_LINE = 32;
+static const int STALL_RUNS = 3;
+
+bool flashCacheEvict() {
+  const esp_partition_t* app = esp_ota_get_running_partition();
+  if (!app || app->size < 2 * FLASH_CACHE_BYTES) {
+    return false;
+  }
+
+  const void* mapped = nullptr;
+  spi_flash_mmap_handle_t handle;
+  if (esp_partition_mmap(app, 0, 2 * FLASH_CACHE_BYTES, SPI_FLASH_MMAP_DATA, &mapped, &handle) != ESP_OK) {
+    return false;
+  }
+
+  const volatile uint8_t* bytes = (const volatile uint8_t*)mapped;
+  uint32_t sink = 0;
+  for (size_t i = 0; i < 2 * FLASH_CACHE_BYTES; i += FLASH_CACHE_LINE) {
+    sink += bytes[i];
+  }
+  (void)sink;
+
+  spi_flash_munmap(handle);
+  return true;
+}
+
+// Decode time of one play-through, frame pacing skipped
+static uint32_t playThrough(AnimPlayer& player, const char* clipName, uint32_t* frames) {
+  if (!player.play(clipName)) {
+    return 0;
+  }
+
+  uint32_t length = player.sequenceLength();
+  uint16_t delay = player.currentClip()->frameDelayMs;
+  unsigned long now = 0;
+  uint32_t total = 0;
+
+  for (uint32_t i = 0; i < length; i++) {
+    unsigned long start = micros();
+    player.update(now);
+    total += micros() - start;
+    now += delay;
+  }
+
+  *frames = length;
+  return total;
+}
+
+bool measureClipCacheStall(const AnimPack* pack, const char* clipName, CacheStallResult* result) {
+  // Own player so the one on screen keeps its frame and stats
+  static AnimPlayer benchPlayer;
+  benchPlayer.begin(pack);
+
+  result->frames = 0;
+  result->coldUs = UINT32_MAX;
+  result->warmUs = UINT32_MAX;
+
+  for (int run = 0; run < STALL_RUNS; run++) {
+    if (!flashCacheEvict()) {
+      return false;
+    }
+    uint32_t cold = playThrough(benchPlayer, clipName, &result->frames);
+    uint32_t warm = playThrough(benchPlayer, clipName, &result->frames);
+    if (result->frames == 0) {
+      return false;
+    }
+    result->coldUs = min(result->coldUs, cold);
+    result->warmUs = min(result->warmUs, warm);
+  }
+  return true;
+}
@@ -0,0 +1,23 @@
+// Flash cache measurements for the animation pack
+// Pack data is read through the ESP32's 32 KB flash cache. Playing a clip
+// once straight after evicting the cache and once more warm shows how much
+// time the asset layout costs in cache refills.
+
+#ifndef FLASH_CACHE_H
+#define FLASH_CACHE_H
+
+#include "anim_pack.h"
+
+struct CacheStallResult {
+  uint32_t frames;
+  uint32_t coldUs;   // Best of a few runs right after an eviction
+  uint32_t warmUs;   // Best of a few runs with the clip already cached
+};
+
+// Streams through twice the cache size of the app image so nothing the
+// pack had cached survives, returns false if the mapping failed
+bool flashCacheEvict();
+
+bool measureClipCacheStall(const AnimPack* pack, const char* clipName, CacheStallResult* result);
+
+#endif
@@ -0,0 +1,99 @@
+#include "gray.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+#define TILE_COLUMNS (ANIM_FRAME_WIDTH / 8)
+#define TILE_ROWS (ANIM_FRAME_HEIGHT / 8)
+
+void GrayDisplay::start(U8G2& display, const uint8_t* msb, const uint8_t* lsb) {
+  planes[0] = msb;
+  planes[1] = lsb;
+  if (!running) {
+    memcpy(display.getBufferPtr(), msb, ANIM_FRAME_BYTES);
+    display.sendBuffer();
+    showing = 0;
+    dueUs = micros() + 2 * GRAY_LSB_US;
+    running = true;
+  }
+}
+
+void GrayDisplay::stop(U8G2& display) {
+  if (!running) {
+    return;
+  }
+  running = false;
+  if (showing != 0) {
+    sendChanged(display, planes[0]);
+  }
+}
+
+uint16_t GrayDisplay::sendChanged(U8G2& display, const uint8_t* plane) {
+  uint8_t* buffer = display.getBufferPtr();
+  uint16_t sent = 0;
+
+  // One transfer per run of changed tiles in a page
+  for (uint8_t ty = 0; ty < TILE_ROWS; ty++) {
+    int runStart = -1;
+    for (uint8_t tx = 0; tx <= TILE_COLUMNS; tx++) {
+      bool changed = false;
+      if (tx < TILE_COLUMNS) {
+        uint8_t* tile = buffer + ty * ANIM_FRAME_WIDTH + tx * 8;
+        const uint8_t* source = plane + ty * ANIM_FRAME_WIDTH + tx * 8;
+        if (memcmp(tile, source, 8) != 0) {
+          memcpy(tile, source, 8);
+          changed = true;
+        }
+      }
+      if (changed && runStart < 0) {
+        runStart = tx;
+      } else if (!changed && runStart >= 0) {
+        display.updateDisplayArea(runStart, ty, tx - runStart, 1);
+        sent += tx - runStart;
+        runStart = -1;
+      }
+    }
+  }
+  return sent;
+}
+
+bool GrayDisplay::update(U8G2& display, unsigned long nowUs) {
+  if (!running || (long)(nowUs - dueUs) < 0) {
+    return false;
+  }
+  if ((long)(nowUs - dueUs) > GRAY_LSB_US / 2) {
+    perf.lateFlips++;
+  }
+
+  showing ^= 1;
+  unsigned long start = micros();
+  uint16_t tiles = sendChanged(display, planes[showing]);
+  uint32_t elapsed = micros() - start;
+
+  // Weighted durations count from when the flip was due, so the ratio holds
+  // while the loop is a little late; too far behind, start over from now
+  dueUs += showing ? GRAY_LSB_US : 2 * GRAY_LSB_US;
+  if ((long)(nowUs - dueUs) > 0) {
+    dueUs = nowUs + (showing ? GRAY_LSB_US : 2 * GRAY_LSB_US);
+  }
+
+  perf.flips++;
+  perf.tiles += tiles;
+  perf.lastFlipUs = elapsed;
+  perf.totalFlipUs += elapsed;
+  if (elapsed > perf.maxFlipUs) {
+    perf.maxFlipUs = elapsed;
+  }
+  if (showing == 0) {
+    if (perf.cycles == 0) {
+      perf.windowStartUs = nowUs;
+    }
+    perf.cycles++;
+    perf.lastCycleUs = nowUs;
+  }
+  return tiles > 0;
+}
+
+void GrayDisplay::resetStats() {
+  memset(&perf, 0, sizeof(perf));
+}
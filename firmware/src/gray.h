@@ -0,0 +1,66 @@
+// Temporal-dither grayscale
+// The SH1106 only turns pixels on or off. A 2 bit frame is kept as two bit
+// planes and the panel is switched between them, the MSB plane shown twice
+// as long as the LSB plane, so levels 0..3 come out as off, dark gray,
+// light gray and white. A flip only sends the 8x8 tiles where the plane
+// differs from what the panel shows (for the eyes, their soft edges), at
+// the bus clock tuned at boot (display_i2c.h). The panel has no sync
+// output, flips aren't aligned with its own refresh and some shimmer is
+// left; a shorter GRAY_LSB_US reduces it if the bus keeps up.
+
+#ifndef GRAY_H
+#define GRAY_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+#include "anim_pack.h"
+
+// LSB plane time, the MSB plane shows for twice this. 6 ms is a 55 Hz cycle.
+#ifndef GRAY_LSB_US
+#define GRAY_LSB_US 6000
+#endif
+
+struct GrayStats {
+  uint32_t flips;
+  uint32_t tiles;        // 8 byte tiles sent
+  uint32_t lateFlips;    // Flipped more than GRAY_LSB_US / 2 after it was due
+  uint32_t lastFlipUs;   // Transfer time
+  uint32_t maxFlipUs;
+  uint64_t totalFlipUs;
+  uint32_t cycles;       // MSB + LSB periods shown
+  uint32_t windowStartUs;
+  uint32_t lastCycleUs;
+};
+
+class GrayDisplay {
+public:
+  // Shows the MSB plane
+  void start(U8G2& display, const uint8_t* msb, const uint8_t* lsb);
+  // Leaves the MSB plane in the display buffer and on the panel
+  void stop(U8G2& display);
+  bool active() const { return running; }
+
+  // Flips to the other plane when due, returns true if it sent something.
+  // The planes are read on every flip, so new frames can be rendered into
+  // them at any time.
+  bool update(U8G2& display, unsigned long nowUs);
+
+  const GrayStats& stats() const { return perf; }
+  void resetStats();
+
+  // Copies the tiles of `plane` that differ from the display buffer into it
+  // and sends just those, returns the number of tiles sent. The display
+  // buffer has to match the panel.
+  static uint16_t sendChanged(U8G2& display, const uint8_t* plane);
+
+private:
+  const uint8_t* planes[2] = {nullptr, nullptr};
+  uint8_t showing = 0;   // 0 MSB, 1 LSB
+  unsigned long dueUs = 0;
+  bool running = false;
+
+  GrayStats perf = {};
+};
+
+#endif
@@ -0,0 +1,14 @@
+// Arduino timing for the native build
+
+#ifndef HOST_TIME_H
+#define HOST_TIME_H
+
+#include <chrono>
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
@@ -0,0 +1,136 @@
+// Native build of the pack reader: loads a pack file through AssetStore the
+// same way the device maps the assets partition, lists its clips and plays
+// one to the terminal with decode timings. Names that aren't pack clips
+// play the procedural face expression of that name.
+//   program <pack.bin>                               list clips
+//   program <pack.bin> <clip> [frames] [interpolate] play a clip, interpolate
+//                                                    is none, dither or morph
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../anim_pack.h"
+#include "../anim_player.h"
+#include "../asset_store.h"
+#include "../face_renderer.h"
+
+static const char* const MODE_NAMES[] = {"forward", "reverse", "pingpong"};
+
+static AssetStore assetStore;
+static AnimPack animPack;
+static AnimPlayer animPlayer;
+static FacePlayer facePlayer;
+
+static bool pixel(const uint8_t* frame, int x, int y) {
+  return frame[(y / 8) * ANIM_FRAME_WIDTH + x] & (1 << (y % 8));
+}
+
+// Two pixel rows per line with half blocks
+static void printFrame(const uint8_t* frame) {
+  for (int y = 0; y < ANIM_FRAME_HEIGHT; y += 2) {
+    for (int x = 0; x < ANIM_FRAME_WIDTH; x++) {
+      bool top = pixel(frame, x, y);
+      bool bottom = pixel(frame, x, y + 1);
+      fputs(top ? (bottom ? "█" : "▀") : (bottom ? "▄" : " "), stdout);
+    }
+    fputc('\n', stdout);
+  }
+}
+
+static int playFace(const char* name, uint32_t frames) {
+  if (!facePlayer.play(name)) {
+    fprintf(stderr, "❌ No clip or face expression named %s\n", name);
+    return 1;
+  }
+  if (frames == 0) {
+    const FaceExpression* expression = faceFindExpression(name);
+    frames = expression->durationMs / FACE_FRAME_MS + 1;
+  }
+
+  unsigned long now = 0;
+  for (uint32_t i = 0; i < frames && !facePlayer.finished(); i++, now += FACE_FRAME_MS) {
+    if (facePlayer.update(now)) {
+      printf("\n--- frame %u ---\n", (unsigned)i);
+      printFrame(facePlayer.frame());
+    }
+  }
+
+  const FacePerfStats& perf = facePlayer.stats();
+  printf("\n✅ %u frames rendered, max %u us\n", (unsigned)perf.framesRendered, (unsigned)perf.maxRenderUs);
+  return 0;
+}
+
+static void listClips() {
+  for (uint16_t i = 0; i < animPack.clipCount(); i++) {
+    const AnimClipEntry* clip = animPack.clip(i);
+    uint32_t frames = 0;
+    for (uint16_t s = 0; s < clip->segmentCount; s++) {
+      frames += animPack.segment(clip->firstSegment + s)->frameCount;
+    }
+    printf("  %-16.16s %4u frames  %2u segments  %4u ms  %s%s\n", clip->name, (unsigned)frames,
+           clip->segmentCount, clip->frameDelayMs, MODE_NAMES[clip->mode],
+           (clip->flags & ANIM_CLIP_LOOP) ? " loop" : "");
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <pack.bin> [clip] [frames]\n", argv[0]);
+    return 2;
+  }
+
+  if (!assetStore.begin(argv[1])) {
+    fprintf(stderr, "❌ %s: %s\n", argv[1], assetStore.error());
+    return 1;
+  }
+  if (!animPack.begin(assetStore.data(), assetStore.size())) {
+    fprintf(stderr, "❌ %s: invalid animation pack\n", argv[1]);
+    return 1;
+  }
+
+  printf("🎬 %u clips, %u frames, %u bytes\n", animPack.clipCount(), animPack.frameCount(),
+         (unsigned)animPack.size());
+  if (argc < 3) {
+    listClips();
+    return 0;
+  }
+
+  animPlayer.begin(&animPack);
+  if (!animPlayer.play(argv[2])) {
+    return playFace(argv[2], argc > 3 ? strtoul(argv[3], nullptr, 10) : 0);
+  }
+
+  uint32_t frames = argc > 3 && argv[3][0] != '0' ? strtoul(argv[3], nullptr, 10) : animPlayer.sequenceLength();
+  if (argc > 4) {
+    uint8_t mode = animBlendFind(argv[4]);
+    if (mode == ANIM_BLEND_MODE_COUNT) {
+      fprintf(stderr, "❌ Unknown interpolation %s\n", argv[4]);
+      return 2;
+    }
+    animPlayer.setInterpolation(mode);
+  }
+
+  // Half steps so in-between frames show up
+  unsigned long now = 0;
+  uint32_t shown = 0;
+  while (shown < frames && !animPlayer.finished()) {
+    uint32_t blended = animPlayer.stats().framesInterpolated;
+    if (animPlayer.update(now)) {
+      if (animPlayer.stats().framesInterpolated != blended) {
+        printf("\n--- in-between ---\n");
+      } else {
+        printf("\n--- frame %u ---\n", (unsigned)shown++);
+      }
+      printFrame(animPlayer.frame());
+    }
+    animPlayer.prefetch();
+    now += animPlayer.currentClip()->frameDelayMs / 2;
+  }
+
+  const AnimPerfStats& perf = animPlayer.stats();
+  printf("\n✅ %u frames decoded, %u errors, max %u us\n", (unsigned)perf.framesDecoded,
+         (unsigned)perf.decodeErrors, (unsigned)perf.maxDecodeUs);
+  printf("   %s: %u in-between frames, max %u us\n", animBlendName(animPlayer.blendMode()),
+         (unsigned)perf.framesInterpolated, (unsigned)perf.maxInterpUs);
+  return perf.decodeErrors ? 1 : 0;
+}
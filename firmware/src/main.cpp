@@ -7,16 +7,36 @@
 #include <ESPmDNS.h>
 #include <DNSServer.h>
 
-// Animation data
-#include "idle01.h"
-#include "focus01.h"
-#include "relax01.h"
-#include "love01.h"
-#include "startup01.h"
-#include "angry_bitmap.h"  // Keep angry as static image
-
-// OLED display configuration - Using U8g2 with SH1106 driver
+// Animation data - compiled from assets/ by tools/build_assets.py
+#ifdef TABBIE_EMBED_ASSETS
+#include "generated/anim_pack_data.h"
+#endif
+#include "anim_pack.h"
+#include "anim_player.h"
+#include "anim_cache.h"
+#include "flash_cache.h"
+#include "asset_store.h"
+#include "asset_upload.h"
+#include "asset_patch.h"
+#include "face_renderer.h"
+#include "scene.h"
+#include "transition.h"
+#include "gray.h"
+#include "display_i2c.h"
+#include "panel_fx.h"
+#include "pixel_shift.h"
+#include "display_governor.h"
+#include "cpu_governor.h"
+#include "compositor.h"
+#include "text.h"
+
+// OLED display configuration - Using U8g2 with SH1106 driver, one I2C
+// transaction per page (display_i2c.h)
+#ifdef DISPLAY_WIRE_I2C
 U8G2_SH1106_128X64_NONAME_F_HW_I2C display(U8G2_R0, /* reset=*/ U8X8_PIN_NONE);
+#else
+U8G2_SH1106_128X64_NONAME_F_IDF_I2C display(U8G2_R0, /* reset=*/ U8X8_PIN_NONE, DISPLAY_SCL_PIN, DISPLAY_SDA_PIN);
+#endif
 
 // Web server on port 80
 WebServer server(80);
@@ -27,10 +47,81 @@ DNSServer dnsServer;
 // WiFi credentials storage
 Preferences preferences;
 
+// Animation pack and the player that decodes it
+AssetStore assetStores[ASSET_SLOT_COUNT];
+uint8_t activeAssetSlot = 0;
+AnimPack animPack;
+AnimPlayer animPlayer;
+AnimFrameCache animCache;
+// Procedural eyes for animation names that aren't pack clips
+FacePlayer facePlayer;
+// Uploaded scene program (POST /api/scene), played as the "scene" animation
+ScenePlayer scenePlayer;
+uint8_t sceneUpload[SCENE_MAX_BYTES];
+size_t sceneUploadSize = 0;
+bool sceneUploadTooLarge = false;
+// Crossfade between display states, see transition.cpp for the rules
+Transition transition;
+String shownState = "startup";
+// Grayscale for procedural faces, requested with "gray": true in /api/animation
+GrayDisplay grayDisplay;
+bool grayFaces = false;
+PanelEffects panelFx;
+PixelShift pixelShift;
+DisplayGovernor governor;
+// Panel-on minutes saved in NVS at boot, and how much of this boot is saved
+uint32_t panelOnBootMinutes = 0;
+uint32_t panelOnSavedMinutes = 0;
+#define PANEL_ON_SAVE_MINUTES 10
+CpuGovernor cpuGovernor;
+// Zone layouts for states that don't redraw the whole screen every frame
+Compositor compositor;
+// Task names that don't fit scroll, /api/marquee sets how
+#define POMODORO_TASK_WIDTH (11 * 8)
+TextMarquee pomodoroTask;
+TextMarquee completeTask;
+// How long loop() can sleep before the display needs it, set by updateDisplay()
+#define LOOP_SLEEP_MS 5
+uint32_t loopSleepMs = LOOP_SLEEP_MS;
+const char* animPackSource = "none";
+
+// POST /api/assets writes the next pack into the slot that isn't playing
+AssetUpload assetUpload;
+// Flash bytes of assetUpload the NVS progress covers, 0 when none is saved
+uint32_t assetUploadSavedWritten = 0;
+AssetPatch assetPatch;
+
+// Chunked uploads (/api/assets/upload) are answered with how much the next
+// request may carry, so flash erases stay short enough to not stall playback
+const uint32_t ASSET_CHUNK_MAX_SECTORS = 8;
+const char* assetChunkError = nullptr;
+int assetChunkStatus = 200;
+
+// /api/perf/hitch: how long to play and how often to write NVS meanwhile
+const unsigned long HITCH_TEST_MS = 3000;
+const unsigned long HITCH_WRITE_INTERVAL_MS = 150;
+
+// /api/perf/refresh: bus clocks to try and transfers timed at each
+const uint32_t REFRESH_TEST_CLOCKS[] = {100000, 400000, 800000, 1000000};
+const int REFRESH_TEST_SENDS = 8;
+
+// /api/perf/text: strings drawn and measured each way
+const int TEXT_TEST_ROUNDS = 200;
+
+// Display transfer timing (reported on /api/perf)
+uint32_t sendBufferCount = 0;
+uint32_t sendBufferSkipped = 0;
+uint32_t lastSendBufferUs = 0;
+uint32_t maxSendBufferUs = 0;
+uint64_t totalSendBufferUs = 0;
+
 // Current state
 String currentAnimation = "startup";
 String currentTask = "";
 unsigned long animationStartTime = 0;
+// Pomodoro length, "minutes" in /api/animation
+#define POMODORO_DEFAULT_MINUTES 25
+uint16_t pomodoroMinutes = POMODORO_DEFAULT_MINUTES;
 unsigned long startupTime = 0;
 bool hasCompletedStartup = false;
 bool isInSetupMode = false;
@@ -66,6 +157,12 @@ const char* MDNS_NAME = "tabbie";
 
 // Function declarations
 void setupDisplay();
+#ifndef DISPLAY_WIRE_I2C
+void tuneDisplayBus(bool force);
+void checkDisplayBus();
+#endif
+void setupAnimations();
+bool activateAssetSlot(uint8_t slot);
 void loadWiFiCredentials();
 void handleWiFiConnection();
 void startSetupMode();
@@ -77,9 +174,43 @@ void handleSetupPage();
 void handleWiFiConfig();
 void handleStatus();
 void handleAnimation();
+void handleEffect();
+void handlePixelShift();
+void handleMarquee();
+void configureMarquees(const MarqueeConfig& config);
+void handlePower();
+void noteActivity(const JsonDocument* request);
+bool timedStateRunning(unsigned long nowMs);
+void savePanelOnTime();
+bool startEffect(const JsonDocument& request);
+void handlePerf();
+void handleCachePerf();
+void handleHitchPerf();
+void handleRefreshPerf();
+void handleTextPerf();
+void handleAssets();
+void handleAssetUpload();
+void handleAssetUploadBody();
+void handleAssetHashes();
+void handleAssetSyncBody();
+void handleAssetUploadStatus();
+void handleAssetChunk();
+void handleAssetChunkBody();
+void handleScene();
+void handleSceneUpload();
+void handleSceneUploadBody();
+void loadScene();
+void resumeAssetUpload();
+void saveAssetUploadProgress();
+void clearAssetUploadProgress();
+uint32_t assetChunkCapacity();
 void handleWiFiSettings();
 void handleCORS();
 void updateDisplay();
+void drawState();
+String displayState();
+void startTransition();
+void updateTransition();
 void drawSetupMode();
 void drawConnecting();
 void drawConnected();
@@ -90,6 +221,15 @@ void drawRelaxAnimation();
 void drawLoveAnimation();
 void drawStartupAnimation();
 void drawAngryImage();
+void drawNamedClip();
+void drawFace();
+bool drawFaceExpression(const char* name);
+void drawScene();
+bool drawClip(const char* clipName);
+void showFrame(const uint8_t* frame);
+void sendDisplayBuffer();
+void transferDisplayBuffer();
+bool blitFrame(uint8_t* dst, const uint8_t* src);
 void drawPomodoroAnimation();
 void drawTaskCompleteAnimation();
 void drawDebugInfo();
@@ -118,11 +258,12 @@ void setup() {
   wifiAttemptCount = 0;
   wifiRetryWaitUntil = 0;
   
+  // Initialize preferences (the animation pack remembers its assets slot)
+  preferences.begin("tabbie", false);
+  
   // Initialize components
   setupDisplay();
-  
-  // Initialize preferences
-  preferences.begin("tabbie", false);
+  setupAnimations();
   
   // Load WiFi credentials (don't connect yet - animations first!)
   loadWiFiCredentials();
@@ -130,21 +271,200 @@ void setup() {
   // DON'T setup web server here - it will be started in startNormalMode() or startSetupMode()
   // after WiFi is properly initialized
   
+  CpuGovernorConfig cpu = CPU_GOVERNOR_DEFAULTS;
+  preferences.getBytes("cpu_governor", &cpu, sizeof(cpu));
+  cpuGovernor.begin(cpu);
+  
   Serial.println("✅ Tabbie initialized - animations will play while WiFi connects");
 }
 
 void setupDisplay() {
-  Wire.begin(21, 22);
-  
+#ifdef DISPLAY_WIRE_I2C
+  Wire.begin(DISPLAY_SDA_PIN, DISPLAY_SCL_PIN);
+#endif
+  display.setBusClock(DISPLAY_BUS_HZ);
   display.begin();
+#ifndef DISPLAY_WIRE_I2C
+  tuneDisplayBus(false);
+#endif
   display.clearBuffer();
   // Don't show "Starting..." text - just clear the display
   // Startup animation will begin immediately in loop()
   display.sendBuffer();
   
+  PixelShiftConfig shift = PIXEL_SHIFT_DEFAULTS;
+  preferences.getBytes("pixel_shift", &shift, sizeof(shift));
+  pixelShift.begin(display, shift);
+  
+  MarqueeConfig marquee = MARQUEE_DEFAULTS;
+  preferences.getBytes("marquee", &marquee, sizeof(marquee));
+  configureMarquees(marquee);
+  
+  GovernorConfig power = GOVERNOR_DEFAULTS;
+  preferences.getBytes("governor", &power, sizeof(power));
+  governor.begin(power, millis());
+  panelOnBootMinutes = preferences.getUInt("panel_on_min", 0);
+  
   Serial.println("✅ OLED Display initialized (U8g2 SH1106)");
 }
 
+#ifndef DISPLAY_WIRE_I2C
+// Uses the clock saved by the last tune if the panel still passes the test
+// at it, otherwise (or when forced) steps through the clocks again
+void tuneDisplayBus(bool force) {
+  uint32_t saved = preferences.getUInt("i2c_hz", 0);
+  uint32_t hz = saved;
+  if (force || hz == 0 || !displayBusTest(display, hz)) {
+    unsigned long start = millis();
+    hz = displayBusTune(display);
+    Serial.printf("🔌 Display bus tuned to %lu Hz in %lu ms (%s)\n", (unsigned long)hz, millis() - start,
+                  displayBusCanRead() ? "readback" : "ACK only");
+  }
+  if (hz != saved) {
+    preferences.putUInt("i2c_hz", hz);
+  }
+  displayBusSetClock(display, hz);
+}
+
+// Frees a stuck bus, and steps the clock down when transfers keep failing.
+// The lower clock only lasts until reboot, where the tune starts again from
+// the saved one.
+void checkDisplayBus() {
+  if (displayBusRecover(display, millis())) {
+    // The panel came back blank with its registers reset, and unchanged
+    // frames aren't sent
+    panelFx.invalidate();
+    pixelShift.invalidate();
+    display.sendBuffer();
+    if (governor.asleep()) {
+      display.setPowerSave(1);
+    }
+    Serial.println("🔌 Display bus recovered");
+  }
+  uint32_t hz = displayBusCheck(display);
+  if (hz) {
+    Serial.printf("⚠️ Display bus errors, clock lowered to %lu Hz\n", (unsigned long)hz);
+  }
+}
+#endif
+
+void setupAnimations() {
+  animCache.begin(ANIM_CACHE_BYTES);
+  animPlayer.begin(&animPack, &animCache);
+
+  // The pack is read in place from the assets partition (pio run -t upload_assets),
+  // starting with the slot the last upload switched to
+  uint8_t preferred = preferences.getUChar("asset_slot", 0) % ASSET_SLOT_COUNT;
+  bool loaded = false;
+  for (uint8_t i = 0; i < ASSET_SLOT_COUNT && !loaded; i++) {
+    uint8_t slot = (preferred + i) % ASSET_SLOT_COUNT;
+    loaded = activateAssetSlot(slot);
+    if (!loaded) {
+      Serial.print("⚠️ Assets slot ");
+      Serial.print(slot);
+      Serial.print(": ");
+      Serial.println(assetStores[slot].error());
+    }
+  }
+
+#ifdef TABBIE_EMBED_ASSETS
+  if (!loaded) {
+    loaded = animPack.begin(anim_pack_data, ANIM_PACK_DATA_SIZE);
+    animPackSource = "firmware";
+  }
+#endif
+
+  if (!loaded) {
+    animPackSource = "none";
+    Serial.println("❌ No animation pack - animations disabled");
+  } else {
+    Serial.print("✅ Animation pack loaded from ");
+    Serial.print(animPackSource);
+    Serial.print(": ");
+    Serial.print(animPack.clipCount());
+    Serial.print(" clips, ");
+    Serial.print(animPack.frameCount());
+    Serial.print(" frames, ");
+    Serial.print(animPack.size());
+    Serial.println(" bytes");
+  }
+  
+  resumeAssetUpload();
+  loadScene();
+}
+
+// Picks up a chunked upload that was cut off by a reboot
+void resumeAssetUpload() {
+  AssetUploadProgress saved;
+  if (preferences.getBytes("asset_upload", &saved, sizeof(saved)) != sizeof(saved)) {
+    return;
+  }
+  
+  // Only into the slot that isn't playing, the active one may have changed since
+  if (saved.slot == activeAssetSlot || !assetUpload.resume(ASSET_PARTITION_LABEL, saved)) {
+    Serial.println("⚠️ Dropping saved animation pack upload");
+    clearAssetUploadProgress();
+    assetUpload.clear();
+    return;
+  }
+  
+  assetUploadSavedWritten = saved.written;
+  
+  Serial.print("📦 Resuming animation pack upload at ");
+  Serial.print(assetUpload.received());
+  Serial.print(" of ");
+  Serial.print(assetUpload.size());
+  Serial.println(" bytes");
+}
+
+// Stores how far a chunked upload got, only what is already in flash counts
+void saveAssetUploadProgress() {
+  if (!assetUpload.isActive()) {
+    return;
+  }
+  AssetUploadProgress progress = assetUpload.progress();
+  if (progress.written == 0 || progress.written == assetUploadSavedWritten) {
+    return;
+  }
+  preferences.putBytes("asset_upload", &progress, sizeof(progress));
+  assetUploadSavedWritten = progress.written;
+}
+
+void clearAssetUploadProgress() {
+  preferences.remove("asset_upload");
+  assetUploadSavedWritten = 0;
+}
+
+// Switches playback to the pack in an assets slot. The current pack stays in
+// use if the new one doesn't validate, otherwise the slot is remembered for
+// the next boot - power loss before that just boots the previous pack.
+bool activateAssetSlot(uint8_t slot) {
+  AssetStore& store = assetStores[slot];
+  AnimPack pack;
+  if (!store.begin(ASSET_PARTITION_LABEL, slot)) {
+    return false;
+  }
+  if (!pack.begin(store.data(), store.size())) {
+    store.end();
+    return false;
+  }
+
+  // The player points into the old mapping, restart it before unmapping
+  uint8_t previous = activeAssetSlot;
+  animPack = pack;
+  animPlayer.begin(&animPack, &animCache);
+  activeAssetSlot = slot;
+  animPackSource = "partition";
+  if (previous != slot) {
+    assetStores[previous].end();
+  }
+
+  if (preferences.getUChar("asset_slot", 0) != slot) {
+    preferences.putUChar("asset_slot", slot);
+  }
+  return true;
+}
+
 void loadWiFiCredentials() {
   Serial.println("📡 Loading WiFi credentials...");
   
@@ -402,6 +722,40 @@ void setupWebServer() {
   server.on("/api/status", HTTP_OPTIONS, handleCORS);
   server.on("/api/animation", HTTP_POST, handleAnimation);
   server.on("/api/animation", HTTP_OPTIONS, handleCORS);
+  server.on("/api/effect", HTTP_POST, handleEffect);
+  server.on("/api/effect", HTTP_OPTIONS, handleCORS);
+  server.on("/api/pixelshift", HTTP_GET, handlePixelShift);
+  server.on("/api/pixelshift", HTTP_POST, handlePixelShift);
+  server.on("/api/pixelshift", HTTP_OPTIONS, handleCORS);
+  server.on("/api/marquee", HTTP_GET, handleMarquee);
+  server.on("/api/marquee", HTTP_POST, handleMarquee);
+  server.on("/api/marquee", HTTP_OPTIONS, handleCORS);
+  server.on("/api/power", HTTP_GET, handlePower);
+  server.on("/api/power", HTTP_POST, handlePower);
+  server.on("/api/power", HTTP_OPTIONS, handleCORS);
+  server.on("/api/perf", HTTP_GET, handlePerf);
+  server.on("/api/perf", HTTP_OPTIONS, handleCORS);
+  server.on("/api/perf/cache", HTTP_GET, handleCachePerf);
+  server.on("/api/perf/cache", HTTP_OPTIONS, handleCORS);
+  server.on("/api/perf/hitch", HTTP_GET, handleHitchPerf);
+  server.on("/api/perf/hitch", HTTP_OPTIONS, handleCORS);
+  server.on("/api/perf/refresh", HTTP_GET, handleRefreshPerf);
+  server.on("/api/perf/refresh", HTTP_OPTIONS, handleCORS);
+  server.on("/api/perf/text", HTTP_GET, handleTextPerf);
+  server.on("/api/perf/text", HTTP_OPTIONS, handleCORS);
+  server.on("/api/assets", HTTP_GET, handleAssets);
+  server.on("/api/assets", HTTP_POST, handleAssetUpload, handleAssetUploadBody);
+  server.on("/api/assets", HTTP_OPTIONS, handleCORS);
+  server.on("/api/assets/hashes", HTTP_GET, handleAssetHashes);
+  server.on("/api/assets/hashes", HTTP_OPTIONS, handleCORS);
+  server.on("/api/assets/sync", HTTP_POST, handleAssetUpload, handleAssetSyncBody);
+  server.on("/api/assets/sync", HTTP_OPTIONS, handleCORS);
+  server.on("/api/assets/upload", HTTP_GET, handleAssetUploadStatus);
+  server.on("/api/assets/upload", HTTP_POST, handleAssetChunk, handleAssetChunkBody);
+  server.on("/api/assets/upload", HTTP_OPTIONS, handleCORS);
+  server.on("/api/scene", HTTP_GET, handleScene);
+  server.on("/api/scene", HTTP_POST, handleSceneUpload, handleSceneUploadBody);
+  server.on("/api/scene", HTTP_OPTIONS, handleCORS);
   server.on("/api/debug", HTTP_POST, handleDebug);
   server.on("/api/debug", HTTP_OPTIONS, handleCORS);
   server.on("/api/reset", HTTP_POST, handleReset);
@@ -415,6 +769,8 @@ void setupWebServer() {
 }
 
 void loop() {
+  cpuGovernor.loopStart();
+  
   // Check if debug button is pressed
   checkDebugButton();
   
@@ -431,8 +787,16 @@ void loop() {
   
   // Update display animation (always runs, never blocked!)
   updateDisplay();
+#ifndef DISPLAY_WIRE_I2C
+  checkDisplayBus();
+#endif
   
-  delay(5);
+  // Decode the next frame now, so it's in RAM when it is due even if a
+  // request in between writes to flash
+  animPlayer.prefetch();
+  
+  // Sleep until the display needs the next pass, or a request could be waiting
+  cpuGovernor.loopEnd(loopSleepMs);
 }
 
 void handleCORS() {
@@ -623,169 +987,1376 @@ void handleStatus() {
   server.send(200, "application/json", response);
 }
 
-void handleReset() {
+void handlePerf() {
   server.sendHeader("Access-Control-Allow-Origin", "*");
   server.sendHeader("Content-Type", "application/json");
   
-  Serial.println("🔄 Resetting WiFi credentials...");
+  const AnimPerfStats& perf = animPlayer.stats();
   
-  // Clear saved WiFi credentials
-  preferences.remove("wifi_ssid");
-  preferences.remove("wifi_password");
+  JsonDocument doc;
+  doc["uptime"] = millis();
+  doc["animation"] = currentAnimation;
   
-  server.send(200, "application/json", "{\"success\":true,\"message\":\"WiFi credentials cleared. Restarting in setup mode...\"}");
+  JsonObject decode = doc["decode"].to<JsonObject>();
+  decode["frames"] = perf.framesDecoded;
+  decode["lastUs"] = perf.lastDecodeUs;
+  decode["maxUs"] = perf.maxDecodeUs;
+  decode["avgUs"] = perf.framesDecoded ? (uint32_t)(perf.totalDecodeUs / perf.framesDecoded) : 0;
+  decode["budgetUs"] = animPack.decodeBudgetUs();
+  decode["overBudget"] = perf.overBudget;
+  decode["errors"] = perf.decodeErrors;
+  decode["prefetched"] = perf.framesPrefetched;
+  
+  // How late frames were ready, hitches are late by more than ANIM_HITCH_US
+  JsonObject timing = doc["timing"].to<JsonObject>();
+  timing["lastLateUs"] = perf.lastLateUs;
+  timing["maxLateUs"] = perf.maxLateUs;
+  timing["avgLateUs"] = perf.framesTimed ? (uint32_t)(perf.totalLateUs / perf.framesTimed) : 0;
+  timing["hitches"] = perf.hitches;
+  
+  // In-between frames, ?interpolate=none|dither|morph overrides the clip
+  // flags for every clip, ?interpolate=clip goes back to them
+  if (server.hasArg("interpolate")) {
+    String setting = server.arg("interpolate");
+    uint8_t mode = animBlendFind(setting.c_str());
+    if (setting == "clip") {
+      animPlayer.setInterpolation(ANIM_INTERPOLATE_CLIP);
+    } else if (mode != ANIM_BLEND_MODE_COUNT) {
+      animPlayer.setInterpolation(mode);
+    }
+  }
+  JsonObject interp = doc["interpolation"].to<JsonObject>();
+  interp["setting"] = animPlayer.interpolationSetting() == ANIM_INTERPOLATE_CLIP
+                          ? "clip" : animBlendName(animPlayer.interpolationSetting());
+  interp["mode"] = animBlendName(animPlayer.blendMode());
+  interp["frames"] = perf.framesInterpolated;
+  interp["lastUs"] = perf.lastInterpUs;
+  interp["maxUs"] = perf.maxInterpUs;
+  interp["avgUs"] = perf.framesInterpolated ? (uint32_t)(perf.totalInterpUs / perf.framesInterpolated) : 0;
+  
+  // Per-codec totals - save this response and pass it to
+  // tools/animpack.py --calibration to refine the encoder's cost model
+  JsonObject codecs = doc["codecs"].to<JsonObject>();
+  for (uint8_t c = 0; c < ANIM_CODEC_COUNT; c++) {
+    JsonObject codec = codecs[animCodecName(c)].to<JsonObject>();
+    codec["frames"] = perf.codecs[c].frames;
+    codec["bytes"] = perf.codecs[c].bytes;
+    codec["totalUs"] = perf.codecs[c].totalUs;
+    codec["maxUs"] = perf.codecs[c].maxUs;
+  }
   
-  delay(1000);
-  ESP.restart();
+  const AnimCacheStats& cacheStats = animCache.stats();
+  uint32_t lookups = cacheStats.hits + cacheStats.misses;
+  JsonObject cache = doc["cache"].to<JsonObject>();
+  cache["hits"] = cacheStats.hits;
+  cache["misses"] = cacheStats.misses;
+  cache["hitRate"] = lookups ? (float)cacheStats.hits / lookups : 0;
+  cache["entries"] = animCache.entries();
+  cache["pinned"] = animCache.pinnedEntries();
+  cache["bytes"] = animCache.bytes();
+  cache["budget"] = animCache.budget();
+  cache["copyUs"] = animCache.copyUs();
+  cache["evictions"] = cacheStats.evictions;
+  cache["shrinks"] = cacheStats.shrinks;
+  cache["freeHeap"] = ESP.getFreeHeap();
+  
+  // Procedural face frames, fps includes sendBuffer and the rest of loop()
+  const FacePerfStats& faceStats = facePlayer.stats();
+  uint32_t faceWindowMs = faceStats.lastFrameMs - faceStats.windowStartMs;
+  JsonObject face = doc["face"].to<JsonObject>();
+  face["frames"] = faceStats.framesRendered;
+  face["lastUs"] = faceStats.lastRenderUs;
+  face["maxUs"] = faceStats.maxRenderUs;
+  face["avgUs"] = faceStats.framesRendered ? (uint32_t)(faceStats.totalRenderUs / faceStats.framesRendered) : 0;
+  face["fps"] = faceWindowMs ? (faceStats.framesRendered - 1) * 1000.0f / faceWindowMs : 0;
+  face["targetFps"] = 1000 / FACE_FRAME_MS;
+  
+  const TransitionStats& transitionStats = transition.stats();
+  JsonObject fade = doc["transition"].to<JsonObject>();
+  fade["count"] = transitionStats.transitions;
+  fade["frames"] = transitionStats.frames;
+  fade["lastUs"] = transitionStats.lastBlendUs;
+  fade["maxUs"] = transitionStats.maxBlendUs;
+  fade["avgUs"] = transitionStats.frames ? (uint32_t)(transitionStats.totalBlendUs / transitionStats.frames) : 0;
+  
+  // Grayscale plane flips, cycleHz is how often both planes were shown
+  const GrayStats& grayStats = grayDisplay.stats();
+  uint32_t grayWindowUs = grayStats.lastCycleUs - grayStats.windowStartUs;
+  JsonObject gray = doc["gray"].to<JsonObject>();
+  gray["active"] = grayDisplay.active();
+  gray["flips"] = grayStats.flips;
+  gray["tilesPerFlip"] = grayStats.flips ? (float)grayStats.tiles / grayStats.flips : 0;
+  gray["lastFlipUs"] = grayStats.lastFlipUs;
+  gray["maxFlipUs"] = grayStats.maxFlipUs;
+  gray["avgFlipUs"] = grayStats.flips ? (uint32_t)(grayStats.totalFlipUs / grayStats.flips) : 0;
+  gray["lateFlips"] = grayStats.lateFlips;
+  gray["cycleHz"] = grayWindowUs ? (grayStats.cycles - 1) * 1000000.0f / grayWindowUs : 0;
+  gray["targetHz"] = 1000000 / (3 * GRAY_LSB_US);
+  
+  // Loop work and sleep, gaps are how long a request may have waited
+  const CpuGovernorStats& cpuStats = cpuGovernor.stats();
+  JsonObject cpu = doc["cpu"].to<JsonObject>();
+  cpu["mhz"] = cpuGovernor.mhz();
+  cpu["lightSleep"] = cpuGovernor.lightSleep();
+  cpu["duty"] = cpuGovernor.duty();
+  cpu["loops"] = cpuStats.loops;
+  cpu["maxWorkUs"] = cpuStats.maxWorkUs;
+  cpu["avgGapMs"] = cpuStats.loops ? cpuStats.totalGapUs / 1000.0f / cpuStats.loops : 0;
+  cpu["maxGapMs"] = cpuStats.maxGapUs / 1000.0f;
+  cpu["latencyMisses"] = cpuStats.latencyMisses;
+  cpu["clockChanges"] = cpuStats.clockChanges;
+  cpu["sAt80"] = cpuStats.msAt[0] / 1000;
+  cpu["sAt160"] = cpuStats.msAt[1] / 1000;
+  cpu["sAt240"] = cpuStats.msAt[2] / 1000;
+  
+  // Panel register effects, bytes is what they sent instead of frames
+  const PanelEffectStats& fxStats = panelFx.stats();
+  JsonObject fx = doc["effects"].to<JsonObject>();
+  fx["effect"] = PanelEffects::name(panelFx.effect());
+  fx["started"] = fxStats.effects;
+  fx["steps"] = fxStats.steps;
+  fx["commands"] = fxStats.commands;
+  fx["bytes"] = fxStats.bytes;
+  
+  // Zone layouts, tilesSent out of tilesDrawn is what the diff saved
+  const CompositorStats& zoneStats = compositor.stats();
+  JsonObject zones = doc["zones"].to<JsonObject>();
+  zones["active"] = compositor.active();
+  zones["updates"] = zoneStats.updates;
+  zones["draws"] = zoneStats.zoneDraws;
+  zones["tilesDrawn"] = zoneStats.tilesDrawn;
+  zones["tilesSent"] = zoneStats.tilesSent;
+  zones["areaSends"] = zoneStats.areaSends;
+  zones["fullSends"] = zoneStats.fullSends;
+  zones["lastUs"] = zoneStats.lastUpdateUs;
+  zones["maxUs"] = zoneStats.maxUpdateUs;
+  
+  JsonObject send = doc["sendBuffer"].to<JsonObject>();
+  send["frames"] = sendBufferCount;
+  send["skipped"] = sendBufferSkipped;
+  send["lastUs"] = lastSendBufferUs;
+  send["maxUs"] = maxSendBufferUs;
+  send["avgUs"] = sendBufferCount ? (uint32_t)(totalSendBufferUs / sendBufferCount) : 0;
+  
+#ifndef DISPLAY_WIRE_I2C
+  const DisplayBusStats& busStats = displayBusStats();
+  JsonObject bus = doc["bus"].to<JsonObject>();
+  bus["transactions"] = busStats.transactions;
+  bus["bytes"] = busStats.bytes;
+  bus["busyUs"] = busStats.busyUs;
+  bus["nacks"] = busStats.nacks;
+  bus["timeouts"] = busStats.timeouts;
+  bus["errors"] = busStats.errors;
+  bus["clockHz"] = displayBusClock();
+  bus["readback"] = displayBusCanRead();
+  bus["fallbacks"] = busStats.fallbacks;
+  bus["absent"] = busStats.absent;
+  bus["stuck"] = displayBusStuck();
+  bus["stuckCount"] = busStats.stuck;
+  bus["recoveries"] = busStats.recoveries;
+  bus["recoveryFailures"] = busStats.recoveryFailures;
+  bus["skipped"] = busStats.skipped;
+  bus["lostUs"] = busStats.lostUs;
+  bus["downMs"] = busStats.downMs;
+#endif
+  
+  JsonObject pack = doc["pack"].to<JsonObject>();
+  pack["valid"] = animPack.isValid();
+  pack["source"] = animPackSource;
+  pack["clips"] = animPack.clipCount();
+  pack["frames"] = animPack.frameCount();
+  pack["bytes"] = animPack.size();
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+  
+  // ?reset=1 starts a fresh measurement window
+  if (server.arg("reset") == "1") {
+    animPlayer.resetStats();
+    animCache.resetStats();
+    facePlayer.resetStats();
+    transition.resetStats();
+    panelFx.resetStats();
+    compositor.resetStats();
+    cpuGovernor.resetStats();
+    grayDisplay.resetStats();
+    displayBusResetStats();
+    sendBufferCount = 0;
+    sendBufferSkipped = 0;
+    lastSendBufferUs = 0;
+    maxSendBufferUs = 0;
+    totalSendBufferUs = 0;
+  }
 }
 
-void handleDebug() {
+// The last uploaded scene survives reboots, it plays when "scene" is requested
+void loadScene() {
+  size_t size = preferences.getBytesLength("scene");
+  if (size == 0 || size > SCENE_MAX_BYTES) {
+    return;
+  }
+  preferences.getBytes("scene", sceneUpload, size);
+  if (!scenePlayer.load(sceneUpload, size)) {
+    Serial.print("⚠️ Saved scene rejected: ");
+    Serial.println(scenePlayer.error());
+    preferences.remove("scene");
+  }
+}
+
+void handleScene() {
   server.sendHeader("Access-Control-Allow-Origin", "*");
   server.sendHeader("Content-Type", "application/json");
   
-  // Activate debug mode - shows device info on OLED for 8 seconds
-  isDebugMode = true;
-  debugModeStartTime = millis();
+  const SceneStats& stats = scenePlayer.stats();
+  JsonDocument doc;
+  doc["loaded"] = scenePlayer.isLoaded();
+  doc["bytes"] = scenePlayer.size();
+  doc["maxBytes"] = SCENE_MAX_BYTES;
+  doc["playing"] = currentAnimation == "scene" && !scenePlayer.finished();
+  doc["error"] = scenePlayer.error();
+  doc["frames"] = stats.frames;
+  doc["lastUs"] = stats.lastRunUs;
+  doc["maxUs"] = stats.maxRunUs;
+  doc["avgUs"] = stats.frames ? (uint32_t)(stats.totalRunUs / stats.frames) : 0;
+  doc["budgetUs"] = SCENE_BUDGET_US;
+  doc["overBudget"] = stats.overBudget;
+  doc["maxOps"] = stats.maxOps;
+  doc["opLimit"] = SCENE_MAX_OPS;
   
-  Serial.println("🔧 Debug mode activated - showing device info on OLED");
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Body of POST /api/scene: a compiled scene (tools/scenec.py), at most SCENE_MAX_BYTES
+void handleSceneUploadBody() {
+  HTTPRaw& raw = server.raw();
+  
+  if (raw.status == RAW_START) {
+    sceneUploadSize = 0;
+    sceneUploadTooLarge = false;
+  } else if (raw.status == RAW_WRITE) {
+    if (sceneUploadSize + raw.currentSize > sizeof(sceneUpload)) {
+      sceneUploadTooLarge = true;
+    } else {
+      memcpy(sceneUpload + sceneUploadSize, raw.buf, raw.currentSize);
+      sceneUploadSize += raw.currentSize;
+    }
+  } else if (raw.status == RAW_ABORTED) {
+    sceneUploadSize = 0;
+  }
+}
+
+void handleSceneUpload() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
   
   JsonDocument response;
-  response["success"] = true;
-  response["message"] = "Debug info displayed on OLED for 8 seconds";
-  response["ip"] = WiFi.localIP().toString();
-  response["ssid"] = WiFi.SSID();
-  response["rssi"] = WiFi.RSSI();
-  response["uptime"] = millis();
-  response["animation"] = currentAnimation;
-  response["wifiStatus"] = wifiStatus;
-  response["mac"] = WiFi.macAddress();
+  int status = 200;
+  if (sceneUploadTooLarge) {
+    response["error"] = "scene too large";
+    status = 413;
+  } else if (!scenePlayer.load(sceneUpload, sceneUploadSize)) {
+    response["error"] = scenePlayer.error();
+    status = 400;
+  } else {
+    preferences.putBytes("scene", sceneUpload, sceneUploadSize);
+    noteActivity(nullptr);
+    currentAnimation = "scene";
+    currentTask = "";
+    animationStartTime = millis();
+    
+    Serial.print("🎬 Scene loaded (");
+    Serial.print(sceneUploadSize);
+    Serial.println(" bytes)");
+    response["bytes"] = sceneUploadSize;
+    response["animation"] = currentAnimation;
+  }
+  response["success"] = status == 200;
   
   String responseStr;
   serializeJson(response, responseStr);
-  server.send(200, "application/json", responseStr);
+  server.send(status, "application/json", responseStr);
 }
 
-void handleAnimation() {
+// Plays every clip once from a cold and once from a warm flash cache - the
+// difference is what the pack layout costs in cache refills. Blocks the
+// loop for a few ms per clip, so it's only run on request.
+void handleCachePerf() {
   server.sendHeader("Access-Control-Allow-Origin", "*");
   server.sendHeader("Content-Type", "application/json");
   
-  if (server.hasArg("plain")) {
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+  JsonDocument doc;
+  JsonArray clips = doc["clips"].to<JsonArray>();
+  uint32_t totalStallUs = 0;
+  
+  for (uint16_t i = 0; i < animPack.clipCount(); i++) {
+    const AnimClipEntry* clip = animPack.clip(i);
+    char name[ANIM_CLIP_NAME_LEN + 1] = {0};
+    strncpy(name, clip->name, ANIM_CLIP_NAME_LEN);
     
-    if (error) {
-      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
-      return;
+    CacheStallResult result;
+    if (!measureClipCacheStall(&animPack, name, &result)) {
+      continue;
     }
     
-    String newAnimation = doc["animation"];
-    String newTask = doc["task"];
+    uint32_t stallUs = result.coldUs > result.warmUs ? result.coldUs - result.warmUs : 0;
+    totalStallUs += stallUs;
     
-    if (newAnimation.length() > 0) {
-      currentAnimation = newAnimation;
-      currentTask = newTask;
-      animationStartTime = millis();
-      
-      Serial.print("🎬 Animation: ");
-      Serial.print(currentAnimation);
-      if (newTask.length() > 0) {
-        Serial.print(" (");
-        Serial.print(newTask);
-        Serial.print(")");
-      }
-      Serial.println();
-      
-      JsonDocument response;
-      response["success"] = true;
-      response["animation"] = currentAnimation;
-      response["task"] = currentTask;
-      
-      String responseStr;
-      serializeJson(response, responseStr);
-      server.send(200, "application/json", responseStr);
-    } else {
-      server.send(400, "application/json", "{\"error\":\"Animation type required\"}");
-    }
-  } else {
-    server.send(400, "application/json", "{\"error\":\"No data received\"}");
+    JsonObject entry = clips.add<JsonObject>();
+    entry["name"] = name;
+    entry["frames"] = result.frames;
+    entry["coldUs"] = result.coldUs;
+    entry["warmUs"] = result.warmUs;
+    entry["stallUs"] = stallUs;
   }
+  doc["totalStallUs"] = totalStallUs;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
 }
 
-void updateDisplay() {
-  // Handle startup animation - play once then go to idle
-  if (!hasCompletedStartup) {
-    drawStartupAnimation();
-    return;
-  }
+void handleAssets() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
   
-  // In setup mode, show setup screen
-  if (isInSetupMode) {
-    drawSetupMode();
-    return;
+  JsonDocument doc;
+  doc["source"] = animPackSource;
+  doc["slot"] = activeAssetSlot;
+  doc["bytes"] = animPack.size();
+  doc["slotBytes"] = AssetStore::slotCapacity(ASSET_PARTITION_LABEL);
+  
+  JsonArray clips = doc["clips"].to<JsonArray>();
+  for (uint16_t i = 0; i < animPack.clipCount(); i++) {
+    const AnimClipEntry* clip = animPack.clip(i);
+    char name[ANIM_CLIP_NAME_LEN + 1] = {0};
+    strncpy(name, clip->name, ANIM_CLIP_NAME_LEN);
+    
+    JsonObject entry = clips.add<JsonObject>();
+    entry["name"] = name;
+    entry["loop"] = (clip->flags & ANIM_CLIP_LOOP) != 0;
   }
   
-  // Handle debug mode - show device info temporarily
-  if (isDebugMode) {
-    if (millis() - debugModeStartTime < DEBUG_MODE_DURATION) {
-      drawDebugInfo();
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Body of POST /api/assets?crc32=<hex>: the raw pack, written straight to
+// flash as it is read off the socket
+void handleAssetUploadBody() {
+  HTTPRaw& raw = server.raw();
+  
+  if (raw.status == RAW_START) {
+    // A pack that can't be checked isn't let near the other slot,
+    // handleAssetUpload() answers with the error
+    if (!server.hasArg("crc32")) {
+      assetUpload.abort();
       return;
-    } else {
-      // Debug mode expired, return to normal
-      isDebugMode = false;
-      Serial.println("🔧 Debug mode ended - returning to normal display");
     }
+    uint8_t slot = (activeAssetSlot + 1) % ASSET_SLOT_COUNT;
+    uint32_t size = server.clientContentLength();
+    uint32_t crc = strtoul(server.arg("crc32").c_str(), nullptr, 16);
+    
+    clearAssetUploadProgress();
+    Serial.print("📦 Receiving animation pack (");
+    Serial.print(size);
+    Serial.print(" bytes) into slot ");
+    Serial.println(slot);
+    if (!assetUpload.begin(ASSET_PARTITION_LABEL, slot, size, crc)) {
+      Serial.print("❌ Upload rejected: ");
+      Serial.println(assetUpload.error());
+    }
+  } else if (raw.status == RAW_WRITE) {
+    assetUpload.write(raw.buf, raw.currentSize);
+  } else if (raw.status == RAW_END) {
+    assetUpload.finish();
+  } else {
+    assetUpload.abort();
   }
-  
-  // Otherwise, always show animations - WiFi connection happens in background
-  if (currentAnimation == "idle") {
-    drawIdleAnimation();
-  } else if (currentAnimation == "focus") {
-    drawFocusAnimation();
-  } else if (currentAnimation == "break") {
-    drawRelaxAnimation();
-  } else if (currentAnimation == "paused") {
-    drawAngryImage();
-  } else if (currentAnimation == "love") {
-    drawLoveAnimation();
-  } else if (currentAnimation == "pomodoro") {
-    drawPomodoroAnimation();
-  } else if (currentAnimation == "complete") {
-    drawTaskCompleteAnimation();
+}
+
+// Bytes the next chunk may carry: as many sectors as can be erased and
+// written in what is left of a frame of the playing clip once it has been
+// decoded and sent, at least one
+uint32_t assetChunkCapacity() {
+  const AnimClipEntry* clip = animPlayer.currentClip();
+  uint32_t frameUs = (clip && clip->frameDelayMs ? clip->frameDelayMs : 100) * 1000UL;
+  uint32_t drawUs = animPlayer.stats().lastDecodeUs + lastSendBufferUs;
+  uint32_t slackUs = frameUs > drawUs ? frameUs - drawUs : 0;
+  uint32_t sectorUs = assetUpload.sectorWriteUs();
+  uint32_t sectors = sectorUs ? slackUs / sectorUs : 1;
+  if (sectors < 1) {
+    sectors = 1;
+  } else if (sectors > ASSET_CHUNK_MAX_SECTORS) {
+    sectors = ASSET_CHUNK_MAX_SECTORS;
   }
+  return sectors * ASSET_SECTOR_SIZE;
 }
 
-void checkDebugButton() {
-  // Don't check button during startup (first 5 seconds) to avoid false triggers
-  if (millis() < 5000) return;
-  
-  // Don't trigger while startup animation is still playing
-  if (!hasCompletedStartup) return;
+// Where a chunked upload stands, so a client can continue after a dropped connection
+void handleAssetUploadStatus() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
   
-  // Don't allow re-triggering while debug mode is active
-  if (isDebugMode) return;
+  JsonDocument doc;
+  doc["active"] = assetUpload.isActive();
+  if (assetUpload.isActive()) {
+    AssetUploadProgress progress = assetUpload.progress();
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08lx", (unsigned long)progress.crc32);
+    doc["size"] = progress.size;
+    doc["crc32"] = crc;
+  }
+  doc["nextOffset"] = assetUpload.isActive() ? assetUpload.received() : 0;
+  doc["maxChunk"] = assetChunkCapacity();
+  doc["sectorUs"] = assetUpload.sectorWriteUs();
   
-  // Check if button is pressed (LOW because of INPUT_PULLUP)
-  if (digitalRead(DEBUG_BUTTON_PIN) == LOW) {
-    // Debounce check
-    if (millis() - lastButtonPress > BUTTON_DEBOUNCE_MS) {
-      lastButtonPress = millis();
-      
-      // Activate debug mode
-      isDebugMode = true;
-      debugModeStartTime = millis();
-      Serial.println("🔘 Debug button pressed - showing device info");
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Body of POST /api/assets/upload?offset=<n>&size=<bytes>&crc32=<hex>: one
+// piece of a pack. Offset 0 of a new pack starts over, anything else has to
+// continue exactly where the current upload is.
+void handleAssetChunkBody() {
+  HTTPRaw& raw = server.raw();
+  
+  if (raw.status == RAW_START) {
+    uint32_t offset = strtoul(server.arg("offset").c_str(), nullptr, 10);
+    uint32_t size = strtoul(server.arg("size").c_str(), nullptr, 10);
+    uint32_t crc = strtoul(server.arg("crc32").c_str(), nullptr, 16);
+    assetChunkError = nullptr;
+    assetChunkStatus = 200;
+    
+    if ((uint32_t)server.clientContentLength() > ASSET_CHUNK_MAX_SECTORS * ASSET_SECTOR_SIZE) {
+      assetChunkError = "chunk too large";
+      assetChunkStatus = 413;
+    } else if (!assetUpload.matches(size, crc)) {
+      if (offset != 0) {
+        assetChunkError = "unknown upload, start at offset 0";
+        assetChunkStatus = 409;
+      } else {
+        uint8_t slot = (activeAssetSlot + 1) % ASSET_SLOT_COUNT;
+        clearAssetUploadProgress();
+        Serial.print("📦 Receiving animation pack in chunks (");
+        Serial.print(size);
+        Serial.print(" bytes) into slot ");
+        Serial.println(slot);
+        if (!assetUpload.begin(ASSET_PARTITION_LABEL, slot, size, crc)) {
+          assetChunkError = assetUpload.error();
+          assetChunkStatus = 400;
+        }
+      }
+    } else if (offset != assetUpload.received()) {
+      assetChunkError = "offset mismatch";
+      assetChunkStatus = 409;
     }
+  } else if (raw.status == RAW_WRITE) {
+    if (!assetChunkError && !assetUpload.write(raw.buf, raw.currentSize)) {
+      assetChunkError = assetUpload.error();
+      assetChunkStatus = 400;
+    }
+  } else if (raw.status == RAW_ABORTED) {
+    // Keep the upload, the client asks for nextOffset and carries on
+    saveAssetUploadProgress();
   }
 }
 
-void drawDebugInfo() {
-  display.clearBuffer();
-  display.setFont(u8g2_font_6x10_tf);
+void handleAssetChunk() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
   
-  // Show different info based on connection state
-  if (isInSetupMode) {
-    // Setup mode - show setup instructions
-    display.drawStr(0, 10, "=== SETUP MODE ===");
+  JsonDocument response;
+  bool complete = false;
+  
+  if (!assetChunkError && assetUpload.isActive() && assetUpload.received() == assetUpload.size()) {
+    clearAssetUploadProgress();
+    if (!assetUpload.finish()) {
+      assetChunkError = assetUpload.error();
+      assetChunkStatus = 400;
+    } else if (!activateAssetSlot(assetUpload.slot())) {
+      assetChunkError = "uploaded pack is invalid";
+      assetChunkStatus = 400;
+    } else {
+      complete = true;
+      Serial.print("✅ Animation pack switched to slot ");
+      Serial.println(activeAssetSlot);
+    }
+    assetUpload.clear();
+  } else {
+    saveAssetUploadProgress();
+  }
+  
+  response["success"] = assetChunkError == nullptr;
+  if (assetChunkError) {
+    response["error"] = assetChunkError;
+  }
+  response["complete"] = complete;
+  if (complete) {
+    response["slot"] = activeAssetSlot;
+    response["bytes"] = animPack.size();
+    response["clips"] = animPack.clipCount();
+  }
+  response["nextOffset"] = assetUpload.isActive() ? assetUpload.received() : 0;
+  response["maxChunk"] = assetChunkCapacity();
+  
+  String responseStr;
+  serializeJson(response, responseStr);
+  server.send(assetChunkStatus, "application/json", responseStr);
+}
+
+// Frame record hashes of the active pack, in frame index order, for
+// building a patch against it
+void handleAssetHashes() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  JsonDocument doc;
+  doc["slot"] = activeAssetSlot;
+  JsonArray frames = doc["frames"].to<JsonArray>();
+  for (uint16_t i = 0; i < animPack.frameCount(); i++) {
+    char hash[9];
+    snprintf(hash, sizeof(hash), "%08lx", (unsigned long)AssetPatch::recordHash(&animPack, i));
+    frames.add(hash);
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Body of POST /api/assets/sync?size=<bytes>&crc32=<hex>: a patch against the
+// active pack that rebuilds the new one in the other slot
+void handleAssetSyncBody() {
+  HTTPRaw& raw = server.raw();
+  
+  if (raw.status == RAW_START) {
+    if (!server.hasArg("crc32")) {
+      assetUpload.abort();
+      assetPatch.begin(&assetUpload, &animPack);
+      return;
+    }
+    uint8_t slot = (activeAssetSlot + 1) % ASSET_SLOT_COUNT;
+    uint32_t size = strtoul(server.arg("size").c_str(), nullptr, 10);
+    uint32_t crc = strtoul(server.arg("crc32").c_str(), nullptr, 16);
+    
+    clearAssetUploadProgress();
+    Serial.print("📦 Receiving animation pack patch (");
+    Serial.print(server.clientContentLength());
+    Serial.print(" of ");
+    Serial.print(size);
+    Serial.print(" bytes) into slot ");
+    Serial.println(slot);
+    if (!assetUpload.begin(ASSET_PARTITION_LABEL, slot, size, crc)) {
+      Serial.print("❌ Upload rejected: ");
+      Serial.println(assetUpload.error());
+    }
+    assetPatch.begin(&assetUpload, &animPack);
+  } else if (raw.status == RAW_WRITE) {
+    assetPatch.write(raw.buf, raw.currentSize);
+  } else if (raw.status == RAW_END) {
+    assetPatch.finish();
+  } else {
+    assetUpload.abort();
+  }
+}
+
+// Answers both full uploads and patches once the body has been written
+void handleAssetUpload() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  JsonDocument response;
+  const char* error = nullptr;
+  if (!server.hasArg("crc32")) {
+    error = "crc32 required";
+  } else if (!assetUpload.isComplete()) {
+    error = assetUpload.error()[0] ? assetUpload.error() : "no pack received";
+  } else if (!activateAssetSlot(assetUpload.slot())) {
+    error = "uploaded pack is invalid";
+  }
+  assetUpload.clear();
+  
+  if (error) {
+    Serial.print("❌ Animation pack upload failed: ");
+    Serial.println(error);
+    response["success"] = false;
+    response["error"] = error;
+    String responseStr;
+    serializeJson(response, responseStr);
+    server.send(400, "application/json", responseStr);
+    return;
+  }
+  
+  Serial.print("✅ Animation pack switched to slot ");
+  Serial.print(activeAssetSlot);
+  Serial.print(": ");
+  Serial.print(animPack.clipCount());
+  Serial.println(" clips");
+  
+  response["success"] = true;
+  response["slot"] = activeAssetSlot;
+  response["bytes"] = animPack.size();
+  response["clips"] = animPack.clipCount();
+  
+  String responseStr;
+  serializeJson(response, responseStr);
+  server.send(200, "application/json", responseStr);
+}
+
+// Plays the current animation for a few seconds while saving to NVS the way
+// handleWiFiConfig() does, once decoding at the deadline and once with
+// prefetch, and reports how late frames were in each run.
+// Resets the /api/perf decode counters.
+void runHitchTest(bool prefetch, JsonObject result) {
+  animPlayer.setPrefetch(prefetch);
+  animPlayer.resetStats();
+  
+  uint32_t writes = 0;
+  uint32_t maxWriteUs = 0;
+  unsigned long start = millis();
+  unsigned long nextWrite = start;
+  while (millis() - start < HITCH_TEST_MS) {
+    if ((long)(millis() - nextWrite) >= 0) {
+      unsigned long writeStart = micros();
+      preferences.putUInt("hitch_test", writes++);
+      uint32_t writeUs = micros() - writeStart;
+      if (writeUs > maxWriteUs) {
+        maxWriteUs = writeUs;
+      }
+      nextWrite += HITCH_WRITE_INTERVAL_MS;
+    }
+    updateDisplay();
+    animPlayer.prefetch();
+    delay(1);
+  }
+  
+  const AnimPerfStats& perf = animPlayer.stats();
+  result["frames"] = perf.framesTimed;
+  result["prefetched"] = perf.framesPrefetched;
+  result["maxLateUs"] = perf.maxLateUs;
+  result["avgLateUs"] = perf.framesTimed ? (uint32_t)(perf.totalLateUs / perf.framesTimed) : 0;
+  result["hitches"] = perf.hitches;
+  result["nvsWrites"] = writes;
+  result["maxNvsWriteUs"] = maxWriteUs;
+}
+
+void handleHitchPerf() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  JsonDocument doc;
+  doc["animation"] = currentAnimation;
+  runHitchTest(false, doc["atDeadline"].to<JsonObject>());
+  runHitchTest(true, doc["prefetch"].to<JsonObject>());
+  preferences.remove("hitch_test");
+  animPlayer.resetStats();
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Measures how fast the panel can be refreshed at each of REFRESH_TEST_CLOCKS:
+// full frames (with the bytes/s and transactions they took on the bus), a
+// single page, and grayscale flips of the neutral face, which gives the
+// highest gray cycle rate the bus allows. Blocks for 1-2 s.
+void handleRefreshPerf() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  // Test planes and the screen to put back afterwards
+  uint8_t* planes = (uint8_t*)malloc(3 * ANIM_FRAME_BYTES);
+  if (!planes) {
+    server.send(500, "application/json", "{\"error\":\"Out of memory\"}");
+    return;
+  }
+  uint8_t* saved = planes + 2 * ANIM_FRAME_BYTES;
+  uint8_t* buffer = display.getBufferPtr();
+  
+  bool grayWasActive = grayDisplay.active();
+  grayDisplay.stop(display);
+  memcpy(saved, buffer, ANIM_FRAME_BYTES);
+  FaceParams params;
+  faceNeutral(&params);
+  faceRenderGray(params, planes, planes + ANIM_FRAME_BYTES);
+  
+  JsonDocument doc;
+#ifdef DISPLAY_WIRE_I2C
+  doc["transport"] = "wire";
+#else
+  doc["transport"] = "idf";
+#endif
+  doc["grayLsbUs"] = GRAY_LSB_US;
+  JsonArray clocks = doc["clocks"].to<JsonArray>();
+  for (uint32_t hz : REFRESH_TEST_CLOCKS) {
+    display.setBusClock(hz);
+    
+    DisplayBusStats before = displayBusStats();
+    unsigned long start = micros();
+    for (int i = 0; i < REFRESH_TEST_SENDS; i++) {
+      display.sendBuffer();
+    }
+    uint32_t fullUs = (micros() - start) / REFRESH_TEST_SENDS;
+    DisplayBusStats after = displayBusStats();
+    
+    start = micros();
+    for (int i = 0; i < REFRESH_TEST_SENDS; i++) {
+      display.updateDisplayArea(0, 0, ANIM_FRAME_WIDTH / 8, 1);
+    }
+    uint32_t pageUs = (micros() - start) / REFRESH_TEST_SENDS;
+    
+    memcpy(buffer, planes, ANIM_FRAME_BYTES);
+    display.sendBuffer();
+    uint32_t tiles = 0;
+    start = micros();
+    for (int i = 0; i < REFRESH_TEST_SENDS; i++) {
+      tiles += GrayDisplay::sendChanged(display, planes + ((i & 1) ? 0 : ANIM_FRAME_BYTES));
+    }
+    uint32_t flipUs = (micros() - start) / REFRESH_TEST_SENDS;
+    
+    JsonObject entry = clocks.add<JsonObject>();
+    entry["hz"] = hz;
+    entry["fullFrameUs"] = fullUs;
+    entry["fullFps"] = fullUs ? 1000000.0f / fullUs : 0;
+#ifndef DISPLAY_WIRE_I2C
+    // Bytes on the wire per second of sendBuffer(), address bytes not counted
+    uint32_t fullBytes = after.bytes - before.bytes;
+    entry["bytesPerSec"] = fullUs ? (uint32_t)((uint64_t)fullBytes * 1000000 / (fullUs * REFRESH_TEST_SENDS)) : 0;
+    entry["transactionsPerFrame"] = (after.transactions - before.transactions) / REFRESH_TEST_SENDS;
+#else
+    (void)before;
+    (void)after;
+#endif
+    entry["pageUs"] = pageUs;
+    entry["grayFlipUs"] = flipUs;
+    entry["grayTilesPerFlip"] = tiles / REFRESH_TEST_SENDS;
+    // A gray cycle is two flips, if they did nothing but transfer
+    entry["grayMaxHz"] = flipUs ? 1000000.0f / (2 * flipUs) : 0;
+  }
+  
+#ifndef DISPLAY_WIRE_I2C
+  // ?retune=1 runs the boot-time clock tune again and saves the result
+  if (server.arg("retune") == "1") {
+    tuneDisplayBus(true);
+  } else {
+    displayBusSetClock(display, displayBusClock());
+  }
+  doc["clockHz"] = displayBusClock();
+#else
+  display.setBusClock(DISPLAY_BUS_HZ);
+#endif
+  memcpy(buffer, saved, ANIM_FRAME_BYTES);
+  display.sendBuffer();
+  free(planes);
+  // drawFaceExpression() starts it again with the next face frame
+  doc["grayWasActive"] = grayWasActive;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// Draws and measures a string through U8g2 and through the glyph atlas
+// (text.h), in the buffer only. ?text= picks the string, the task name by
+// default. The atlas is timed with the text on a page boundary and off it.
+void handleTextPerf() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  String sample = server.hasArg("text") ? server.arg("text") : currentTask;
+  if (sample.length() == 0) {
+    sample = "Write the quarterly report";
+  }
+  const char* text = sample.c_str();
+  
+  uint8_t* saved = (uint8_t*)malloc(ANIM_FRAME_BYTES);
+  if (!saved) {
+    server.send(500, "application/json", "{\"error\":\"Out of memory\"}");
+    return;
+  }
+  uint8_t* buffer = display.getBufferPtr();
+  memcpy(saved, buffer, ANIM_FRAME_BYTES);
+  // Also brings the atlas into the flash cache before it is timed
+  uint32_t atlasWidth = textWidth(GLYPH_FONT_6X10, text);
+  
+  display.setFont(u8g2_font_6x10_tf);
+  unsigned long start = micros();
+  for (int i = 0; i < TEXT_TEST_ROUNDS; i++) {
+    display.drawStr(0, 9 + (i & 7), text);
+  }
+  float u8g2DrawUs = (float)(micros() - start) / TEXT_TEST_ROUNDS;
+  volatile uint32_t u8g2Width = 0;
+  start = micros();
+  for (int i = 0; i < TEXT_TEST_ROUNDS; i++) {
+    u8g2Width = display.getStrWidth(text);
+  }
+  float u8g2WidthUs = (float)(micros() - start) / TEXT_TEST_ROUNDS;
+  
+  start = micros();
+  for (int i = 0; i < TEXT_TEST_ROUNDS; i++) {
+    textDraw(buffer, GLYPH_FONT_6X10, 0, 8 + GLYPH_FONT_6X10.ascent, text);
+  }
+  float alignedUs = (float)(micros() - start) / TEXT_TEST_ROUNDS;
+  start = micros();
+  for (int i = 0; i < TEXT_TEST_ROUNDS; i++) {
+    textDraw(buffer, GLYPH_FONT_6X10, 0, 9 + GLYPH_FONT_6X10.ascent + (i % 7), text);
+  }
+  float shiftedUs = (float)(micros() - start) / TEXT_TEST_ROUNDS;
+  volatile uint32_t width = 0;
+  start = micros();
+  for (int i = 0; i < TEXT_TEST_ROUNDS; i++) {
+    width = textWidth(GLYPH_FONT_6X10, text);
+  }
+  float atlasWidthUs = (float)(micros() - start) / TEXT_TEST_ROUNDS;
+  (void)width;
+  
+  memcpy(buffer, saved, ANIM_FRAME_BYTES);
+  free(saved);
+  
+  JsonDocument doc;
+  doc["text"] = text;
+  doc["rounds"] = TEXT_TEST_ROUNDS;
+  JsonObject u8g2 = doc["u8g2"].to<JsonObject>();
+  u8g2["drawUs"] = u8g2DrawUs;
+  u8g2["widthUs"] = u8g2WidthUs;
+  u8g2["width"] = u8g2Width;
+  JsonObject atlas = doc["atlas"].to<JsonObject>();
+  atlas["drawAlignedUs"] = alignedUs;
+  atlas["drawShiftedUs"] = shiftedUs;
+  atlas["widthUs"] = atlasWidthUs;
+  atlas["width"] = atlasWidth;
+  atlas["bytes6x10"] = textAtlasBytes(GLYPH_FONT_6X10);
+  atlas["bytes10x20"] = textAtlasBytes(GLYPH_FONT_10X20);
+  doc["speedup"] = shiftedUs > 0 ? u8g2DrawUs / shiftedUs : 0;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+void handleReset() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  Serial.println("🔄 Resetting WiFi credentials...");
+  
+  // Clear saved WiFi credentials
+  preferences.remove("wifi_ssid");
+  preferences.remove("wifi_password");
+  
+  server.send(200, "application/json", "{\"success\":true,\"message\":\"WiFi credentials cleared. Restarting in setup mode...\"}");
+  
+  delay(1000);
+  ESP.restart();
+}
+
+void handleDebug() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  noteActivity(nullptr);
+  
+  // Activate debug mode - shows device info on OLED for 8 seconds
+  isDebugMode = true;
+  debugModeStartTime = millis();
+  
+  Serial.println("🔧 Debug mode activated - showing device info on OLED");
+  
+  JsonDocument response;
+  response["success"] = true;
+  response["message"] = "Debug info displayed on OLED for 8 seconds";
+  response["ip"] = WiFi.localIP().toString();
+  response["ssid"] = WiFi.SSID();
+  response["rssi"] = WiFi.RSSI();
+  response["uptime"] = millis();
+  response["animation"] = currentAnimation;
+  response["wifiStatus"] = wifiStatus;
+  response["mac"] = WiFi.macAddress();
+  
+  String responseStr;
+  serializeJson(response, responseStr);
+  server.send(200, "application/json", responseStr);
+}
+
+void handleAnimation() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  if (server.hasArg("plain")) {
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, server.arg("plain"));
+    
+    if (error) {
+      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      return;
+    }
+    
+    String newAnimation = doc["animation"];
+    String newTask = doc["task"];
+    
+    if (newAnimation.length() > 0) {
+      // Checked before anything changes, a rejected request leaves the animation alone
+      bool withEffect = !doc["effect"].isNull();
+      if (withEffect && PanelEffects::find(doc["effect"] | "") >= PANEL_FX_COUNT) {
+        server.send(400, "application/json", "{\"error\":\"Unknown effect\"}");
+        return;
+      }
+      noteActivity(&doc);
+      currentAnimation = newAnimation;
+      currentTask = newTask;
+      animationStartTime = millis();
+      grayFaces = doc["gray"] | false;
+      // Two digits of minutes fit the countdown
+      pomodoroMinutes = constrain(doc["minutes"] | POMODORO_DEFAULT_MINUTES, 1, 99);
+      // Optional, the effect keeps running across animations until replaced
+      if (withEffect) {
+        startEffect(doc);
+      }
+      
+      Serial.print("🎬 Animation: ");
+      Serial.print(currentAnimation);
+      if (newTask.length() > 0) {
+        Serial.print(" (");
+        Serial.print(newTask);
+        Serial.print(")");
+      }
+      Serial.println();
+      
+      JsonDocument response;
+      response["success"] = true;
+      response["animation"] = currentAnimation;
+      response["task"] = currentTask;
+      response["gray"] = grayFaces;
+      response["effect"] = PanelEffects::name(panelFx.effect());
+      
+      String responseStr;
+      serializeJson(response, responseStr);
+      server.send(200, "application/json", responseStr);
+    } else {
+      server.send(400, "application/json", "{\"error\":\"Animation type required\"}");
+    }
+  } else {
+    server.send(400, "application/json", "{\"error\":\"No data received\"}");
+  }
+}
+
+// {"effect": "breathe", "periodMs": 3000, "amount": 16}, period and amount
+// are optional. "none" stops the effect.
+bool startEffect(const JsonDocument& request) {
+  const char* name = request["effect"] | "";
+  uint8_t effect = PanelEffects::find(name);
+  if (effect >= PANEL_FX_COUNT) {
+    return false;
+  }
+  panelFx.start(effect, request["periodMs"] | 0, request["amount"] | 0, millis());
+  Serial.printf("✨ Effect: %s\n", name);
+  return true;
+}
+
+void handleEffect() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  JsonDocument doc;
+  if (!server.hasArg("plain") || deserializeJson(doc, server.arg("plain"))) {
+    server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+    return;
+  }
+  if (!startEffect(doc)) {
+    server.send(400, "application/json", "{\"error\":\"Unknown effect\"}");
+    return;
+  }
+  noteActivity(&doc);
+  
+  JsonDocument response;
+  response["success"] = true;
+  response["effect"] = PanelEffects::name(panelFx.effect());
+  String responseStr;
+  serializeJson(response, responseStr);
+  server.send(200, "application/json", responseStr);
+}
+
+// The pomodoro and task complete lines scroll the same way
+void configureMarquees(const MarqueeConfig& config) {
+  pomodoroTask.configure(config);
+  completeTask.configure(config);
+}
+
+// How task names scroll: "mode" "loop" or "bounce", "pxPerS", "pauseMs" at
+// the ends and "gapPx" between laps. Saved in NVS.
+void handleMarquee() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  static const char* const MODE_NAMES[MARQUEE_MODE_COUNT] = {"loop", "bounce"};
+  if (server.method() == HTTP_POST) {
+    JsonDocument request;
+    if (!server.hasArg("plain") || deserializeJson(request, server.arg("plain"))) {
+      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      return;
+    }
+    MarqueeConfig marquee = pomodoroTask.config();
+    if (!request["mode"].isNull()) {
+      const char* mode = request["mode"] | "";
+      marquee.mode = MARQUEE_MODE_COUNT;
+      for (uint8_t i = 0; i < MARQUEE_MODE_COUNT; i++) {
+        if (strcmp(mode, MODE_NAMES[i]) == 0) {
+          marquee.mode = i;
+        }
+      }
+      if (marquee.mode == MARQUEE_MODE_COUNT) {
+        server.send(400, "application/json", "{\"error\":\"Unknown mode\"}");
+        return;
+      }
+    }
+    marquee.pxPerS = request["pxPerS"] | marquee.pxPerS;
+    marquee.pauseMs = request["pauseMs"] | marquee.pauseMs;
+    marquee.gapPx = request["gapPx"] | marquee.gapPx;
+    configureMarquees(marquee);
+    preferences.putBytes("marquee", &pomodoroTask.config(), sizeof(MarqueeConfig));
+  }
+  
+  const MarqueeConfig& marquee = pomodoroTask.config();
+  JsonDocument doc;
+  doc["mode"] = MODE_NAMES[marquee.mode];
+  doc["pxPerS"] = marquee.pxPerS;
+  doc["pauseMs"] = marquee.pauseMs;
+  doc["gapPx"] = marquee.gapPx;
+  doc["frameMs"] = TEXT_MARQUEE_FRAME_MS;
+  // The pomodoro task line
+  doc["text"] = pomodoroTask.text();
+  doc["width"] = pomodoroTask.width();
+  doc["scrolls"] = pomodoroTask.scrolls(POMODORO_TASK_WIDTH);
+  doc["stripBytes"] = pomodoroTask.stripBytes();
+  doc["stripRenders"] = pomodoroTask.renders() + completeTask.renders();
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// GET reports the burn-in pixel shift, POST {"enabled": true, "range": 1,
+// "intervalS": 120} changes it (any of the three) and saves it
+void handlePixelShift() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  if (server.method() == HTTP_POST) {
+    JsonDocument request;
+    if (!server.hasArg("plain") || deserializeJson(request, server.arg("plain"))) {
+      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      return;
+    }
+    PixelShiftConfig shift = pixelShift.config();
+    shift.enabled = request["enabled"] | (bool)shift.enabled;
+    shift.range = request["range"] | shift.range;
+    shift.intervalS = request["intervalS"] | shift.intervalS;
+    pixelShift.configure(shift);
+    preferences.putBytes("pixel_shift", &pixelShift.config(), sizeof(PixelShiftConfig));
+  }
+  
+  const PixelShiftConfig& shift = pixelShift.config();
+  const PixelShiftStats& shiftStats = pixelShift.stats();
+  JsonDocument doc;
+  doc["enabled"] = (bool)shift.enabled;
+  doc["range"] = shift.range;
+  doc["intervalS"] = shift.intervalS;
+  doc["dx"] = pixelShift.dx();
+  doc["dy"] = pixelShift.dy();
+  doc["steps"] = shiftStats.steps;
+  doc["resends"] = shiftStats.resends;
+  doc["rowResets"] = shiftStats.rowResets;
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+void updateDisplay() {
+  // Debug mode expired, return to normal
+  if (isDebugMode && millis() - debugModeStartTime >= DEBUG_MODE_DURATION) {
+    isDebugMode = false;
+    Serial.println("🔧 Debug mode ended - returning to normal display");
+  }
+  
+  unsigned long now = millis();
+  // Someone is following a countdown or scene without sending anything
+  if (timedStateRunning(now)) {
+    governor.activity(now);
+  }
+  if (governor.update(display, panelFx, now)) {
+    Serial.printf("💤 Display %s\n", DisplayGovernor::stageName(governor.stage()));
+    if (governor.asleep()) {
+      // Leaves the MSB plane in the panel's RAM for waking up
+      grayDisplay.stop(display);
+    }
+  }
+  
+  // The panel is off, nothing to draw or send until something happens
+  loopSleepMs = LOOP_SLEEP_MS;
+  if (!governor.asleep()) {
+    startTransition();
+    if (governor.frameDue(now)) {
+      // Clips set loopSleepMs to when their next frame is due
+      drawState();
+    } else {
+      loopSleepMs = governor.msUntilFrame(now);
+    }
+    updateTransition();
+    grayDisplay.update(display, micros());
+    pixelShift.update(display, panelFx, now, !transition.active());
+  } else {
+    loopSleepMs = governor.msUntilFrame(now);
+  }
+  panelFx.update(display, now);
+  savePanelOnTime();
+  
+  if (transition.active() && loopSleepMs > LOOP_SLEEP_MS) {
+    loopSleepMs = LOOP_SLEEP_MS;
+  }
+  if (panelFx.effect() != PANEL_FX_NONE && loopSleepMs > PANEL_FX_STEP_MS) {
+    loopSleepMs = PANEL_FX_STEP_MS;
+  }
+  // Grayscale flips every few ms
+  if (grayDisplay.active()) {
+    loopSleepMs = 1;
+  }
+}
+
+// Commands that change what is shown keep the display awake. Requests can
+// carry the time, "time" in seconds since 1970 and "utcOffset" in minutes.
+void noteActivity(const JsonDocument* request) {
+  unsigned long now = millis();
+  governor.activity(now);
+  if (request && !(*request)["time"].isNull()) {
+    governor.setTime((*request)["time"] | 0UL, (*request)["utcOffset"] | 0, now);
+  }
+}
+
+// A pomodoro until its countdown runs out, a scene until it ends
+bool timedStateRunning(unsigned long nowMs) {
+  if (currentAnimation == "pomodoro") {
+    return nowMs - animationStartTime < pomodoroMinutes * 60000UL;
+  }
+  return currentAnimation == "scene" && !scenePlayer.finished();
+}
+
+void savePanelOnTime() {
+  uint32_t minutes = (uint32_t)(governor.panelOnMs(millis()) / 60000);
+  if (minutes >= panelOnSavedMinutes + PANEL_ON_SAVE_MINUTES) {
+    preferences.putUInt("panel_on_min", panelOnBootMinutes + minutes);
+    panelOnSavedMinutes = minutes;
+  }
+}
+
+// GET reports the governors, POST changes any of slowAfterS, dimAfterS,
+// sleepAfterS, slowFrameMs, dimScale, quietStart and quietEnd (display) and
+// cpuGovernor, lightSleep, maxLatencyMs and workBudgetMs (CPU) and saves
+// them, and sets the time if it has "time". POST counts as activity.
+void handlePower() {
+  server.sendHeader("Access-Control-Allow-Origin", "*");
+  server.sendHeader("Content-Type", "application/json");
+  
+  unsigned long now = millis();
+  if (server.method() == HTTP_POST) {
+    JsonDocument request;
+    if (!server.hasArg("plain") || deserializeJson(request, server.arg("plain"))) {
+      server.send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+      return;
+    }
+    GovernorConfig power = governor.config();
+    power.slowAfterS = request["slowAfterS"] | power.slowAfterS;
+    power.dimAfterS = request["dimAfterS"] | power.dimAfterS;
+    power.sleepAfterS = request["sleepAfterS"] | power.sleepAfterS;
+    power.slowFrameMs = request["slowFrameMs"] | power.slowFrameMs;
+    power.dimScale = request["dimScale"] | power.dimScale;
+    power.quietStart = (request["quietStart"] | power.quietStart) % 24;
+    power.quietEnd = (request["quietEnd"] | power.quietEnd) % 24;
+    governor.configure(power);
+    preferences.putBytes("governor", &governor.config(), sizeof(GovernorConfig));
+    
+    CpuGovernorConfig cpu = cpuGovernor.config();
+    cpu.enabled = request["cpuGovernor"] | (bool)cpu.enabled;
+    cpu.lightSleep = request["lightSleep"] | (bool)cpu.lightSleep;
+    cpu.maxLatencyMs = request["maxLatencyMs"] | cpu.maxLatencyMs;
+    cpu.workBudgetMs = request["workBudgetMs"] | cpu.workBudgetMs;
+    cpuGovernor.configure(cpu);
+    preferences.putBytes("cpu_governor", &cpuGovernor.config(), sizeof(CpuGovernorConfig));
+    noteActivity(&request);
+  }
+  
+  const GovernorConfig& power = governor.config();
+  const GovernorStats& powerStats = governor.stats();
+  JsonDocument doc;
+  doc["stage"] = DisplayGovernor::stageName(governor.stage());
+  doc["idleS"] = governor.idleMs(now) / 1000;
+  doc["localHour"] = governor.localHour(now);
+  doc["slowAfterS"] = power.slowAfterS;
+  doc["dimAfterS"] = power.dimAfterS;
+  doc["sleepAfterS"] = power.sleepAfterS;
+  doc["slowFrameMs"] = power.slowFrameMs;
+  doc["dimScale"] = power.dimScale;
+  doc["quietStart"] = power.quietStart;
+  doc["quietEnd"] = power.quietEnd;
+  // Over the panel's life, and since boot
+  doc["panelOnHours"] = (panelOnBootMinutes + governor.panelOnMs(now) / 60000) / 60.0f;
+  doc["panelOnS"] = (uint32_t)(governor.panelOnMs(now) / 1000);
+  doc["framesSkipped"] = powerStats.framesSkipped;
+  doc["sleeps"] = powerStats.sleeps;
+  doc["wakes"] = powerStats.wakes;
+  const CpuGovernorConfig& cpu = cpuGovernor.config();
+  doc["cpuGovernor"] = (bool)cpu.enabled;
+  doc["lightSleep"] = (bool)cpu.lightSleep;
+  doc["lightSleepActive"] = cpuGovernor.lightSleep();
+  doc["maxLatencyMs"] = cpu.maxLatencyMs;
+  doc["workBudgetMs"] = cpu.workBudgetMs;
+  doc["cpuMhz"] = cpuGovernor.mhz();
+  JsonObject stages = doc["stageS"].to<JsonObject>();
+  for (uint8_t i = 0; i < GOVERNOR_STAGE_COUNT; i++) {
+    stages[DisplayGovernor::stageName(i)] = powerStats.stageMs[i] / 1000;
+  }
+  
+  String response;
+  serializeJson(doc, response);
+  server.send(200, "application/json", response);
+}
+
+// What updateDisplay() shows, transitions are picked by it
+String displayState() {
+  if (!hasCompletedStartup) {
+    return "startup";
+  }
+  if (isInSetupMode) {
+    return "setup";
+  }
+  if (isDebugMode) {
+    return "debug";
+  }
+  return currentAnimation;
+}
+
+// Starts a transition when the state changed since the last update. The
+// display buffer still holds the last frame of the state being left.
+void startTransition() {
+  String state = displayState();
+  if (state == shownState) {
+    return;
+  }
+  
+  // Grayscale belongs to the face state, the MSB plane is what is left on screen
+  grayDisplay.stop(display);
+  compositor.end();
+  const TransitionRule* rule = transitionFind(shownState.c_str(), state.c_str());
+  if (rule) {
+    transition.begin(display.getBufferPtr(), *rule, millis());
+  } else {
+    transition.cancel();
+  }
+  shownState = state;
+}
+
+// Sends the blend of the old screen and the new state's frame, and the
+// plain frame once the transition is over
+void updateTransition() {
+  if (!transition.active()) {
+    return;
+  }
+  
+  uint8_t* buffer = display.getBufferPtr();
+  if (transition.finish(millis())) {
+    transferDisplayBuffer();
+  } else if (transition.compose(buffer, millis())) {
+    transferDisplayBuffer();
+    transition.restore(buffer);
+  }
+}
+
+void drawState() {
+  // Handle startup animation - play once then go to idle
+  if (!hasCompletedStartup) {
+    drawStartupAnimation();
+    return;
+  }
+  
+  // In setup mode, show setup screen
+  if (isInSetupMode) {
+    drawSetupMode();
+    return;
+  }
+  
+  // Handle debug mode - show device info temporarily
+  if (isDebugMode) {
+    drawDebugInfo();
+    return;
+  }
+  
+  // Otherwise, always show animations - WiFi connection happens in background
+  if (currentAnimation == "idle") {
+    drawIdleAnimation();
+  } else if (currentAnimation == "focus") {
+    drawFocusAnimation();
+  } else if (currentAnimation == "break") {
+    drawRelaxAnimation();
+  } else if (currentAnimation == "paused") {
+    drawAngryImage();
+  } else if (currentAnimation == "love") {
+    drawLoveAnimation();
+  } else if (currentAnimation == "pomodoro") {
+    drawPomodoroAnimation();
+  } else if (currentAnimation == "complete") {
+    drawTaskCompleteAnimation();
+  } else if (currentAnimation == "scene") {
+    drawScene();
+  } else if (animPack.findClip(currentAnimation.c_str()) >= 0) {
+    drawNamedClip();
+  } else if (faceFindExpression(currentAnimation.c_str())) {
+    drawFace();
+  }
+}
+
+void checkDebugButton() {
+  // Don't check button during startup (first 5 seconds) to avoid false triggers
+  if (millis() < 5000) return;
+  
+  // Don't trigger while startup animation is still playing
+  if (!hasCompletedStartup) return;
+  
+  // Don't allow re-triggering while debug mode is active
+  if (isDebugMode) return;
+  
+  // Check if button is pressed (LOW because of INPUT_PULLUP)
+  if (digitalRead(DEBUG_BUTTON_PIN) == LOW) {
+    // Debounce check
+    if (millis() - lastButtonPress > BUTTON_DEBOUNCE_MS) {
+      lastButtonPress = millis();
+      
+      // The press that wakes the display does only that
+      if (governor.activity(millis())) {
+        Serial.println("🔘 Button pressed - display woken");
+        return;
+      }
+      
+      // Activate debug mode
+      isDebugMode = true;
+      debugModeStartTime = millis();
+      Serial.println("🔘 Debug button pressed - showing device info");
+    }
+  }
+}
+
+void drawDebugInfo() {
+  display.clearBuffer();
+  display.setFont(u8g2_font_6x10_tf);
+  
+  // Show different info based on connection state
+  if (isInSetupMode) {
+    // Setup mode - show setup instructions
+    display.drawStr(0, 10, "=== SETUP MODE ===");
     display.drawStr(0, 24, "Connect to WiFi:");
     display.drawStr(0, 36, "  Tabbie-Setup");
     display.drawStr(0, 48, "Then visit:");
@@ -947,211 +2518,315 @@ void drawError() {
   display.sendBuffer();
 }
 
-void drawIdleAnimation() {
-  static int currentFrame = 0;
-  static unsigned long lastFrameTime = 0;
-  
-  unsigned long currentTime = millis();
+// Plays a clip from the animation pack, returns true once a play-once clip has finished
+bool drawClip(const char* clipName) {
+  if (!animPlayer.isPlaying(clipName) && !animPlayer.play(clipName)) {
+    // Missing clip - report it as finished so play-once states move on
+    return true;
+  }
   
-  // Update frame at 24fps using IDLE01_FRAME_DELAY (41ms per frame)
-  if (currentTime - lastFrameTime >= IDLE01_FRAME_DELAY) {
-    display.clearBuffer();
-    
-    // Get the frame from PROGMEM
-    const uint8_t* frameData = (const uint8_t*)pgm_read_ptr(&idle01_frames[currentFrame]);
-    display.drawBitmap(0, 0, 128 / 8, 64, frameData);
-    
-    display.sendBuffer();
-    
-    currentFrame++;
-    if (currentFrame >= IDLE01_FRAME_COUNT) {
-      currentFrame = 0;
-    }
-    
-    lastFrameTime = currentTime;
+  if (animPlayer.update(millis())) {
+    showFrame(animPlayer.frame());
   }
+  loopSleepMs = animPlayer.msUntilUpdate(millis());
+  
+  return animPlayer.finished();
 }
 
-void drawFocusAnimation() {
-  static int currentFrame = 0;
-  static unsigned long lastFrameTime = 0;
-  
-  unsigned long currentTime = millis();
+// Copies a decoded page-format frame into the display buffer and sends it
+void showFrame(const uint8_t* frame) {
+  // Hold frames and static images are already on the panel - skip the I2C transfer
+  if (!blitFrame(display.getBufferPtr(), frame)) {
+    sendBufferSkipped++;
+    return;
+  }
   
-  // Update frame at 12fps using FOCUS01_FRAME_DELAY
-  if (currentTime - lastFrameTime >= FOCUS01_FRAME_DELAY) {
-    display.clearBuffer();
-    
-    // Get the frame from PROGMEM
-    const uint8_t* frameData = (const uint8_t*)pgm_read_ptr(&focus01_frames[currentFrame]);
-    display.drawBitmap(0, 0, 128 / 8, 64, frameData);
-    
-    display.sendBuffer();
-    
-    currentFrame++;
-    if (currentFrame >= FOCUS01_FRAME_COUNT) {
-      currentFrame = 0;  // Loop continuously
-    }
-    
-    lastFrameTime = currentTime;
+  sendDisplayBuffer();
+}
+
+// Sends the display buffer. During a transition updateTransition() sends
+// blended frames instead.
+void sendDisplayBuffer() {
+  if (!transition.active()) {
+    transferDisplayBuffer();
   }
 }
 
-void drawRelaxAnimation() {
-  static int currentFrame = 0;
-  static unsigned long lastFrameTime = 0;
+// Sends the display buffer and times the transfer
+void transferDisplayBuffer() {
+  unsigned long start = micros();
+  display.sendBuffer();
+  lastSendBufferUs = micros() - start;
   
-  unsigned long currentTime = millis();
+  sendBufferCount++;
+  totalSendBufferUs += lastSendBufferUs;
+  if (lastSendBufferUs > maxSendBufferUs) {
+    maxSendBufferUs = lastSendBufferUs;
+  }
+}
+
+// Compares and copies a frame into the display buffer in one pass, returns
+// false if nothing changed. Lives in IRAM and only touches RAM, so it never
+// waits for flash, even right after an NVS write flushed the flash cache.
+bool IRAM_ATTR blitFrame(uint8_t* dst, const uint8_t* src) {
+  bool changed = false;
+  
+  if (((uintptr_t)dst | (uintptr_t)src) & 3) {
+    for (int i = 0; i < ANIM_FRAME_BYTES; i++) {
+      if (dst[i] != src[i]) {
+        dst[i] = src[i];
+        changed = true;
+      }
+    }
+    return changed;
+  }
   
-  // Update frame at 12fps using RELAX01_FRAME_DELAY
-  if (currentTime - lastFrameTime >= RELAX01_FRAME_DELAY) {
-    display.clearBuffer();
-    
-    // Get the frame from PROGMEM
-    const uint8_t* frameData = (const uint8_t*)pgm_read_ptr(&relax01_frames[currentFrame]);
-    display.drawBitmap(0, 0, 128 / 8, 64, frameData);
-    
-    display.sendBuffer();
-    
-    currentFrame++;
-    if (currentFrame >= RELAX01_FRAME_COUNT) {
-      currentFrame = 0;  // Loop continuously
+  uint32_t* d = (uint32_t*)dst;
+  const uint32_t* s = (const uint32_t*)src;
+  for (int i = 0; i < ANIM_FRAME_BYTES / 4; i++) {
+    if (d[i] != s[i]) {
+      d[i] = s[i];
+      changed = true;
     }
-    
-    lastFrameTime = currentTime;
   }
+  return changed;
+}
+
+void drawIdleAnimation() {
+  drawClip("idle01");
+}
+
+void drawFocusAnimation() {
+  drawClip("focus01");
+}
+
+void drawRelaxAnimation() {
+  drawClip("relax01");
 }
 
 void drawLoveAnimation() {
-  static int currentFrame = 0;
-  static unsigned long lastFrameTime = 0;
   static unsigned long lastAnimationStart = 0;
 
-  // Reset animation timing when a new love animation is triggered
+  // Restart the clip when a new love animation is triggered
   if (animationStartTime != lastAnimationStart) {
-    currentFrame = 0;
-    lastFrameTime = 0;
+    animPlayer.play("love01");
     lastAnimationStart = animationStartTime;
   }
   
-  unsigned long currentTime = millis();
-  
-  // Update frame at 8fps using LOVE01_FRAME_DELAY
-  if (currentTime - lastFrameTime >= LOVE01_FRAME_DELAY) {
-    display.clearBuffer();
-    
-    // Get the frame from PROGMEM
-    const uint8_t* frameData = (const uint8_t*)pgm_read_ptr(&love01_frames[currentFrame]);
-    display.drawBitmap(0, 0, 128 / 8, 64, frameData);
-    
-    display.sendBuffer();
-    
-    currentFrame++;
-    if (currentFrame >= LOVE01_FRAME_COUNT) {
-      // Play once fully, then return to idle
-      currentAnimation = "idle";
-      currentTask = "";
-      currentFrame = 0;
-      lastAnimationStart = 0; // allow restart next time
-      return;
-    }
-    
-    lastFrameTime = currentTime;
+  if (drawClip("love01")) {
+    // Play once fully, then return to idle
+    currentAnimation = "idle";
+    currentTask = "";
+    lastAnimationStart = 0; // allow restart next time
   }
 }
 
 void drawStartupAnimation() {
-  static int currentFrame = 0;
-  static unsigned long lastFrameTime = 0;
-  static bool hasPlayedOnce = false;
-  
-  unsigned long currentTime = millis();
-  
-  // Update frame at 8fps using STARTUP01_FRAME_DELAY
-  if (currentTime - lastFrameTime >= STARTUP01_FRAME_DELAY) {
-    display.clearBuffer();
-    
-    // Get the frame from PROGMEM
-    const uint8_t* frameData = (const uint8_t*)pgm_read_ptr(&startup01_frames[currentFrame]);
-    display.drawBitmap(0, 0, 128 / 8, 64, frameData);
-    
-    display.sendBuffer();
-    
-    currentFrame++;
-    if (currentFrame >= STARTUP01_FRAME_COUNT) {
-      // Play once fully, then switch to idle
-      hasCompletedStartup = true;
-      currentAnimation = "idle";
-      currentFrame = 0;
-      hasPlayedOnce = false;
-      return;
-    }
-    
-    lastFrameTime = currentTime;
+  if (drawClip("startup01")) {
+    // Play once fully, then switch to idle
+    hasCompletedStartup = true;
+    currentAnimation = "idle";
   }
 }
 
+// Base eyes plus brow and anger mark sprites instead of a full 1 KB frame
 void drawAngryImage() {
-  display.clearBuffer();
-  display.drawBitmap(0, 0, 128 / 8, 64, angry_bitmap);
-  display.sendBuffer();
+  static unsigned long lastAnimationStart = 0;
+
+  if (animationStartTime != lastAnimationStart) {
+    facePlayer.play("angry");
+    lastAnimationStart = animationStartTime;
+  }
+  
+  drawFaceExpression("angry");
 }
 
-void drawPomodoroAnimation() {
-  static int frame = 0;
-  frame++;
+// Any other animation name plays the pack clip of that name, e.g. clips
+// uploaded through /api/assets. Play-once clips return to idle.
+void drawNamedClip() {
+  static unsigned long lastAnimationStart = 0;
+
+  if (animationStartTime != lastAnimationStart) {
+    animPlayer.play(currentAnimation.c_str());
+    lastAnimationStart = animationStartTime;
+  }
   
-  display.clearBuffer();
+  if (drawClip(currentAnimation.c_str())) {
+    currentAnimation = "idle";
+    currentTask = "";
+    lastAnimationStart = 0;
+  }
+}
+
+// Plays a procedural expression (face_renderer.h), rendered every
+// FACE_FRAME_MS. Returns true once a play-once expression has finished.
+bool drawFaceExpression(const char* name) {
+  if (!facePlayer.isPlaying(name) && !facePlayer.play(name)) {
+    return true;
+  }
   
-  // Focused face
-  display.setFont(u8g2_font_10x20_tf);
-  display.drawStr(45, 20, "(>.<)");
+  facePlayer.setGray(grayFaces);
+  bool rendered = facePlayer.update(millis());
   
-  // Task name
-  display.setFont(u8g2_font_6x10_tf);
-  String taskDisplay = currentTask;
-  if (taskDisplay.length() > 21) {
-    taskDisplay = taskDisplay.substring(0, 18) + "...";
+  // Grayscale waits for transitions, which blend 1 bit frames. Once it runs,
+  // updateDisplay() flips the planes the player renders into.
+  if (grayFaces && !transition.active()) {
+    if ((rendered || facePlayer.finished()) && !grayDisplay.active()) {
+      grayDisplay.start(display, facePlayer.frame(), facePlayer.grayPlane());
+    }
+    return facePlayer.finished();
   }
-  display.drawStr(0, 35, taskDisplay.c_str());
+  grayDisplay.stop(display);
   
-  // Focus indicator
-  display.drawStr(30, 48, "FOCUS!");
+  // A finished expression holds its last frame, showFrame() skips the
+  // transfer unless something else was drawn in the meantime
+  if (rendered || facePlayer.finished()) {
+    showFrame(facePlayer.frame());
+  }
   
-  if ((frame / 10) % 2 == 0) {
-    display.drawStr(85, 48, "[*]");
-  } else {
-    display.drawStr(85, 48, "[!]");
+  return facePlayer.finished();
+}
+
+// Animation names that are expressions rather than pack clips.
+// Play-once expressions return to idle like pack clips.
+void drawFace() {
+  static unsigned long lastAnimationStart = 0;
+
+  if (animationStartTime != lastAnimationStart) {
+    facePlayer.play(currentAnimation.c_str());
+    lastAnimationStart = animationStartTime;
+  }
+  
+  if (drawFaceExpression(currentAnimation.c_str())) {
+    currentAnimation = "idle";
+    currentTask = "";
+    lastAnimationStart = 0;
+  }
+}
+
+// Runs the uploaded scene, which draws straight into the display buffer.
+// Returns to idle when it ends or was stopped for running too long.
+void drawScene() {
+  static unsigned long lastAnimationStart = 0;
+
+  if (animationStartTime != lastAnimationStart) {
+    scenePlayer.restart();
+    lastAnimationStart = animationStartTime;
   }
   
-  // Progress bar
-  int progress = (frame * 2) % 128;
-  display.drawFrame(0, 55, 128, 8);
-  display.drawBox(1, 56, progress, 6);
+  if (scenePlayer.update(display, millis())) {
+    sendDisplayBuffer();
+  }
   
-  display.sendBuffer();
+  if (scenePlayer.finished()) {
+    if (scenePlayer.error()[0]) {
+      Serial.print("❌ Scene stopped: ");
+      Serial.println(scenePlayer.error());
+    }
+    currentAnimation = "idle";
+    currentTask = "";
+    lastAnimationStart = 0;
+  }
+}
+
+// Pomodoro screen: eyes on top, task name and countdown below, progress bar
+// at the bottom. Each part is a zone (compositor.h), so the countdown only
+// sends its own tiles once a second while the eyes move at FACE_FRAME_MS.
+#define POMODORO_FACE_SCALE 0.75f
+
+enum PomodoroZone : uint8_t {
+  POMODORO_ZONE_FACE,
+  POMODORO_ZONE_TASK,
+  POMODORO_ZONE_TIME,
+  POMODORO_ZONE_PROGRESS,
+};
+
+uint32_t pomodoroElapsedMs(unsigned long nowMs) {
+  uint32_t total = pomodoroMinutes * 60000UL;
+  uint32_t elapsed = nowMs - animationStartTime;
+  return elapsed < total ? elapsed : total;
+}
+
+// The eyes shrunk into the top five pages
+void drawPomodoroFace(U8G2& display, unsigned long nowMs) {
+  static const uint8_t SCALED[] = {FACE_SPACING, FACE_EYE_Y, FACE_WIDTH, FACE_HEIGHT, FACE_TILT,
+                                   FACE_LOOK_X,  FACE_LOOK_Y, FACE_PUPIL};
+  facePlayer.update(nowMs);
+  FaceParams params = facePlayer.params();
+  for (uint8_t param : SCALED) {
+    params.values[param] *= POMODORO_FACE_SCALE;
+  }
+  faceDraw(params, display.getBufferPtr());
+}
+
+// Text rows start on page 5, so glyphs are copied without shifting
+#define POMODORO_TEXT_Y (5 * 8 + GLYPH_FONT_6X10.ascent)
+
+void drawPomodoroTask(U8G2& display, unsigned long nowMs) {
+  pomodoroTask.draw(display.getBufferPtr(), 0, POMODORO_TEXT_Y, POMODORO_TASK_WIDTH, nowMs);
+}
+
+void drawPomodoroTime(U8G2& display, unsigned long nowMs) {
+  uint32_t leftS = (pomodoroMinutes * 60000UL - pomodoroElapsedMs(nowMs) + 999) / 1000;
+  char text[12];
+  snprintf(text, sizeof(text), "%02u:%02u", (unsigned)(leftS / 60), (unsigned)(leftS % 60));
+  textDraw(display.getBufferPtr(), GLYPH_FONT_6X10, 96, POMODORO_TEXT_Y, text);
+}
+
+void drawPomodoroProgress(U8G2& display, unsigned long nowMs) {
+  int progress = (uint64_t)pomodoroElapsedMs(nowMs) * 126 / (pomodoroMinutes * 60000UL);
+  display.drawFrame(0, 57, 128, 6);
+  display.drawBox(1, 58, progress, 4);
+}
+
+// In tiles: the bottom three pages split between text and the bar
+const Zone POMODORO_ZONES[] = {
+  {0, 0, 16, 5, FACE_FRAME_MS, drawPomodoroFace},
+  {0, 5, 11, 2, 0, drawPomodoroTask},
+  {11, 5, 5, 2, 1000, drawPomodoroTime},
+  {0, 7, 16, 1, 1000, drawPomodoroProgress},
+};
+
+void drawPomodoroAnimation() {
+  static unsigned long lastAnimationStart = 0;
+  unsigned long now = millis();
+
+  // A new request or coming back from another state lays out the screen again
+  if (animationStartTime != lastAnimationStart || !compositor.active()) {
+    facePlayer.play("eyes");
+    facePlayer.setGray(false);
+    pomodoroTask.set(GLYPH_FONT_6X10, currentTask.length() > 0 ? currentTask.c_str() : "FOCUS!", now);
+    display.clearBuffer();
+    compositor.begin(POMODORO_ZONES, sizeof(POMODORO_ZONES) / sizeof(POMODORO_ZONES[0]), now);
+    // A task name too long for its zone scrolls
+    if (pomodoroTask.scrolls(POMODORO_TASK_WIDTH)) {
+      compositor.setPeriod(POMODORO_ZONE_TASK, TEXT_MARQUEE_FRAME_MS, now);
+    }
+    lastAnimationStart = animationStartTime;
+  }
+  
+  // During a transition the blend is sent instead
+  compositor.update(display, now, !transition.active());
+  loopSleepMs = compositor.msUntilUpdate(millis());
 }
 
 void drawTaskCompleteAnimation() {
   static int frame = 0;
   frame++;
+  unsigned long now = millis();
   
   display.clearBuffer();
+  uint8_t* buffer = display.getBufferPtr();
   
   // Happy face
-  display.setFont(u8g2_font_10x20_tf);
-  display.drawStr(45, 20, "(^.^)");
+  textDraw(buffer, GLYPH_FONT_10X20, 45, 20, "(^.^)");
   
   // Celebration
-  display.setFont(u8g2_font_6x10_tf);
-  display.drawStr(20, 35, "Great job!");
+  textDraw(buffer, GLYPH_FONT_6X10, 20, 35, "Great job!");
   
-  // Task completed
-  String taskDisplay = currentTask;
-  if (taskDisplay.length() > 21) {
-    taskDisplay = taskDisplay.substring(0, 18) + "...";
-  }
-  display.drawStr(0, 50, taskDisplay.c_str());
+  // Task completed, scrolls if it doesn't fit
+  completeTask.set(GLYPH_FONT_6X10, currentTask.c_str(), now);
+  completeTask.draw(buffer, 0, 50, ANIM_FRAME_WIDTH, now);
   
   // Sparkle animation
   if (frame % 20 < 10) {
@@ -1161,7 +2836,7 @@ void drawTaskCompleteAnimation() {
     display.drawPixel(110, 45);
   }
   
-  display.sendBuffer();
+  sendDisplayBuffer();
   
   // Auto return to idle after 5 seconds
   if (millis() - animationStartTime > 5000) {
@@ -0,0 +1,129 @@
+#include "panel_fx.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "anim_pack.h"
+
+static const char* const EFFECT_NAMES[PANEL_FX_COUNT] = {
+  "none", "breathe", "fade_in", "fade_out", "invert", "flash", "bounce", "scroll",
+};
+
+// Period and amount used when start() gets 0
+static const uint16_t DEFAULT_PERIOD_MS[PANEL_FX_COUNT] = {0, 3000, 600, 600, 0, 400, 800, 2000};
+static const uint8_t DEFAULT_AMOUNT[PANEL_FX_COUNT] = {0, 0x10, 0, 0, 0, 0, 6, 0};
+
+const char* PanelEffects::name(uint8_t effect) {
+  return effect < PANEL_FX_COUNT ? EFFECT_NAMES[effect] : "unknown";
+}
+
+uint8_t PanelEffects::find(const char* name) {
+  for (uint8_t i = 0; i < PANEL_FX_COUNT; i++) {
+    if (strcmp(EFFECT_NAMES[i], name) == 0) {
+      return i;
+    }
+  }
+  return PANEL_FX_COUNT;
+}
+
+void PanelEffects::start(uint8_t effect, uint16_t periodMs, uint8_t effectAmount, unsigned long nowMs) {
+  if (effect >= PANEL_FX_COUNT) {
+    effect = PANEL_FX_NONE;
+  }
+  current = effect;
+  period = periodMs ? periodMs : DEFAULT_PERIOD_MS[effect];
+  amount = effectAmount ? effectAmount : DEFAULT_AMOUNT[effect];
+  startMs = nowMs;
+  // First step goes out with the next update
+  lastStepMs = nowMs - PANEL_FX_STEP_MS;
+  if (effect != PANEL_FX_NONE) {
+    perf.effects++;
+  }
+}
+
+void PanelEffects::invalidate() {
+  sentContrast = -1;
+  sentInverted = -1;
+  sentLine = -1;
+}
+
+void PanelEffects::resetStats() {
+  perf = {};
+}
+
+void PanelEffects::sendCommand(U8G2& display, uint8_t command) {
+  display.sendF("c", command);
+  perf.commands++;
+  perf.bytes++;
+}
+
+bool PanelEffects::update(U8G2& display, unsigned long nowMs) {
+  bool known = sentContrast >= 0 && sentInverted >= 0 && sentLine >= 0;
+  if (known && (long)(nowMs - lastStepMs) < PANEL_FX_STEP_MS) {
+    return false;
+  }
+  lastStepMs = nowMs;
+
+  uint32_t elapsed = nowMs - startMs;
+  float phase = period ? (float)(elapsed % period) / period : 0;
+  int16_t contrast = PANEL_CONTRAST;
+  int8_t inverted = 0;
+  int8_t line = 0;
+
+  switch (current) {
+    case PANEL_FX_BREATHE:
+      // Cosine from full down to `amount` and back up
+      contrast = amount + (int16_t)lroundf((PANEL_CONTRAST - amount) * (0.5f + 0.5f * cosf(2 * (float)M_PI * phase)));
+      break;
+    case PANEL_FX_FADE_IN:
+    case PANEL_FX_FADE_OUT: {
+      float t = elapsed >= period ? 1 : (float)elapsed / period;
+      if (current == PANEL_FX_FADE_OUT) {
+        t = 1 - t;
+      }
+      // Brightness looks roughly quadratic in contrast, so ease in
+      contrast = (int16_t)lroundf(PANEL_CONTRAST * t * t);
+      break;
+    }
+    case PANEL_FX_INVERT:
+      inverted = 1;
+      break;
+    case PANEL_FX_FLASH:
+      if (amount == 0 || elapsed / period < amount) {
+        inverted = phase < 0.5f;
+      }
+      break;
+    case PANEL_FX_BOUNCE:
+      // Rows move up when the start line goes up
+      line = (int8_t)lroundf(amount * sinf((float)M_PI * phase));
+      break;
+    case PANEL_FX_SCROLL:
+      line = (int8_t)(phase * ANIM_FRAME_HEIGHT);
+      break;
+  }
+  line = (line + lineOffset) & (ANIM_FRAME_HEIGHT - 1);
+  contrast = contrast * contrastScale / 255;
+
+  uint32_t commands = perf.commands;
+  if (contrast != sentContrast) {
+    // 0x81 takes the value as its argument byte
+    display.setContrast(contrast);
+    perf.commands++;
+    perf.bytes += 2;
+    sentContrast = contrast;
+  }
+  if (inverted != sentInverted) {
+    sendCommand(display, inverted ? 0xa7 : 0xa6);
+    sentInverted = inverted;
+  }
+  if (line != sentLine) {
+    sendCommand(display, 0x40 | line);
+    sentLine = line;
+  }
+
+  if (perf.commands == commands) {
+    return false;
+  }
+  perf.steps++;
+  return true;
+}
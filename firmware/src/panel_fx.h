@@ -0,0 +1,87 @@
+// Effects done by the panel instead of by sending frames
+// The SH1106 has registers for contrast (0x81), inverse display (0xA6/0xA7)
+// and the RAM row shown at the top (0x40-0x7F, wrapping around). Breathing,
+// fades, flashes and bounces only change those, a step costs 1-2 command
+// bytes instead of a 1 KB frame, and whatever is drawing keeps drawing
+// underneath. update() works out the register values for the current time
+// and sends the ones that changed. The start line also carries the pixel
+// shift's row offset (pixel_shift.h), effects move relative to it.
+
+#ifndef PANEL_FX_H
+#define PANEL_FX_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+// Contrast when no effect changes it
+#ifndef PANEL_CONTRAST
+#define PANEL_CONTRAST 0xcf
+#endif
+
+// Registers are updated at most this often
+#define PANEL_FX_STEP_MS 20
+
+enum PanelEffect : uint8_t {
+  PANEL_FX_NONE,
+  PANEL_FX_BREATHE,   // Contrast down to `amount` and back, every period
+  PANEL_FX_FADE_IN,   // Contrast from 0 up over the period, then stays
+  PANEL_FX_FADE_OUT,  // Contrast down to 0 over the period, then stays dark
+  PANEL_FX_INVERT,    // Inverted until stopped
+  PANEL_FX_FLASH,     // Inverted for half of each period, `amount` times (0 for ever)
+  PANEL_FX_BOUNCE,    // Up by `amount` rows and back, every period
+  PANEL_FX_SCROLL,    // All 64 rows scroll up once per period, wrapping around
+  PANEL_FX_COUNT
+};
+
+struct PanelEffectStats {
+  uint32_t effects;   // Started
+  uint32_t steps;     // Updates that changed a register
+  uint32_t commands;
+  uint32_t bytes;     // Command bytes, without control bytes
+};
+
+class PanelEffects {
+public:
+  // `periodMs` and `amount` of 0 use the effect's defaults. Starting
+  // PANEL_FX_NONE puts the registers back to normal.
+  void start(uint8_t effect, uint16_t periodMs, uint8_t amount, unsigned long nowMs);
+  void stop() { current = PANEL_FX_NONE; }
+  uint8_t effect() const { return current; }
+
+  // Sends the registers that changed, at most every PANEL_FX_STEP_MS.
+  // Returns true if it sent anything.
+  bool update(U8G2& display, unsigned long nowMs);
+  // The panel was re-initialised, send every register again
+  void invalidate();
+  // Rows the whole image is moved up by, under any effect
+  void setLineOffset(int8_t rows) { lineOffset = rows; }
+  // Contrast is scaled by this / 255, for dimming under any effect
+  void setContrastScale(uint8_t scale) { contrastScale = scale; }
+
+  static const char* name(uint8_t effect);
+  // PANEL_FX_COUNT if unknown
+  static uint8_t find(const char* name);
+
+  const PanelEffectStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  void sendCommand(U8G2& display, uint8_t command);
+
+  uint8_t current = PANEL_FX_NONE;
+  uint16_t period = 0;
+  uint8_t amount = 0;
+  unsigned long startMs = 0;
+  unsigned long lastStepMs = 0;
+  int8_t lineOffset = 0;
+  uint8_t contrastScale = 255;
+
+  // What the panel has, -1 when unknown
+  int16_t sentContrast = -1;
+  int8_t sentInverted = -1;
+  int8_t sentLine = -1;
+
+  PanelEffectStats perf = {};
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include "pixel_shift.h"
+
+#include "anim_pack.h"
+
+// Columns of SH1106 RAM, the panel shows the middle 128
+#define RAM_COLUMNS 132
+
+// Position `step` on a snake path over the square: along a row, one down,
+// back along the next row, and the same way back up after the last one, so
+// each step moves one pixel. Step 0 is the centre.
+static void pathPosition(uint16_t step, uint8_t range, int8_t* dx, int8_t* dy) {
+  uint16_t width = 2 * range + 1;
+  uint16_t count = width * width;
+  uint16_t k = (step + count / 2) % (2 * (count - 1));
+  uint16_t index = k < count ? k : 2 * (count - 1) - k;
+  uint16_t row = index / width;
+  uint16_t column = index % width;
+  if (row & 1) {
+    column = width - 1 - column;
+  }
+  *dx = (int8_t)column - range;
+  *dy = (int8_t)row - range;
+}
+
+void PixelShift::begin(U8G2& display, const PixelShiftConfig& config) {
+  baseOffset = display.getU8x8()->x_offset;
+  configure(config);
+}
+
+void PixelShift::configure(const PixelShiftConfig& config) {
+  settings = config;
+  if (settings.range < 1) {
+    settings.range = 1;
+  } else if (settings.range > PIXEL_SHIFT_MAX_RANGE) {
+    settings.range = PIXEL_SHIFT_MAX_RANGE;
+  }
+  if (settings.intervalS == 0) {
+    settings.intervalS = 1;
+  }
+  step = 0;
+  moved = true;
+}
+
+void PixelShift::resetStats() {
+  perf = {};
+}
+
+// Columns outside the 128 being written would keep whatever was there
+// before, and after a column step some of them are visible
+void PixelShift::clearMargins(U8G2& display) {
+  static uint8_t blank[RAM_COLUMNS - ANIM_FRAME_WIDTH] = {};
+  u8x8_t* u8x8 = display.getU8x8();
+  uint8_t left = u8x8->x_offset;
+  uint8_t right = RAM_COLUMNS - ANIM_FRAME_WIDTH - left;
+
+  u8x8_cad_StartTransfer(u8x8);
+  for (uint8_t page = 0; page < ANIM_FRAME_HEIGHT / 8; page++) {
+    if (left) {
+      u8x8_cad_SendCmd(u8x8, 0xb0 | page);
+      u8x8_cad_SendCmd(u8x8, 0x10);
+      u8x8_cad_SendCmd(u8x8, 0x00);
+      u8x8_cad_SendData(u8x8, left, blank);
+    }
+    if (right) {
+      uint8_t column = left + ANIM_FRAME_WIDTH;
+      u8x8_cad_SendCmd(u8x8, 0xb0 | page);
+      u8x8_cad_SendCmd(u8x8, 0x10 | (column >> 4));
+      u8x8_cad_SendCmd(u8x8, column & 0x0f);
+      u8x8_cad_SendData(u8x8, right, blank);
+    }
+  }
+  u8x8_cad_EndTransfer(u8x8);
+  marginsClear = true;
+}
+
+// The SH1106 has exactly 64 rows of RAM, so moving the start line wraps
+// the rows pushed off one edge round to the other. Only screens with
+// nothing in the `range` rows at each edge can move up or down.
+static bool edgeRowsBlank(const uint8_t* buffer, uint8_t range) {
+  uint8_t top = (1 << range) - 1;
+  uint8_t bottom = (uint8_t)(0xff << (8 - range));
+  const uint8_t* last = buffer + (ANIM_FRAME_HEIGHT / 8 - 1) * ANIM_FRAME_WIDTH;
+  for (uint8_t column = 0; column < ANIM_FRAME_WIDTH; column++) {
+    if ((buffer[column] & top) || (last[column] & bottom)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PixelShift::update(U8G2& display, PanelEffects& effects, unsigned long nowMs, bool bufferShown) {
+  if (!marginsClear && bufferShown) {
+    clearMargins(display);
+  }
+  bool rowsFree = edgeRowsBlank(display.getBufferPtr(), settings.range);
+  if (y != 0 && !rowsFree) {
+    // Something was drawn at an edge, back to the rows it was drawn for
+    y = 0;
+    effects.setLineOffset(0);
+    perf.rowResets++;
+    return true;
+  }
+  bool due = moved || (settings.enabled && nowMs - lastStepMs >= settings.intervalS * 1000UL);
+  if (!due) {
+    return false;
+  }
+
+  uint16_t next = moved ? step : step + 1;
+  int8_t nextX = 0;
+  int8_t nextY = 0;
+  if (settings.enabled) {
+    pathPosition(next, settings.range, &nextX, &nextY);
+  }
+  if (!rowsFree) {
+    nextY = 0;
+  }
+  if (nextX != x && !bufferShown) {
+    return false;
+  }
+
+  step = next;
+  lastStepMs = nowMs;
+  moved = false;
+  if (nextX == x && nextY == y) {
+    return false;
+  }
+  perf.steps++;
+
+  // A higher start line moves the image up
+  y = nextY;
+  effects.setLineOffset(-y);
+
+  if (nextX != x) {
+    x = nextX;
+    display.getU8x8()->x_offset = baseOffset + x;
+    clearMargins(display);
+    display.sendBuffer();
+    perf.resends++;
+  }
+  return true;
+}
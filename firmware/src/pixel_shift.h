@@ -0,0 +1,73 @@
+// Burn-in protection for the always-on screens
+// Every interval the whole image moves by one pixel, wandering over a small
+// square around where it was drawn, so the same pixels aren't lit all day.
+// Nothing is redrawn: rows move through the SH1106's start line (via
+// PanelEffects), columns through the column offset U8g2 adds to every write.
+// The start line wraps rows round to the other edge, so screens that use
+// their top or bottom rows (the pomodoro bar) only move sideways.
+// The SH1106 can't move columns of what it already shows, so a column step
+// clears the margin uncovered and sends the frame on screen once more.
+// Drawing code keeps using the 128x64 buffer as before.
+
+#ifndef PIXEL_SHIFT_H
+#define PIXEL_SHIFT_H
+
+#include <U8g2lib.h>
+#include <stdint.h>
+
+#include "panel_fx.h"
+
+// The SH1106 has 2 spare columns on each side
+#define PIXEL_SHIFT_MAX_RANGE 2
+
+struct PixelShiftConfig {
+  uint8_t enabled;
+  uint8_t range;        // Pixels in each direction, 1..PIXEL_SHIFT_MAX_RANGE
+  uint16_t intervalS;   // Between steps
+};
+
+#define PIXEL_SHIFT_DEFAULTS {1, 1, 120}
+
+struct PixelShiftStats {
+  uint32_t steps;
+  uint32_t resends;     // Frames sent again for column steps
+  uint32_t rowResets;   // Moved back to row 0 for something drawn at an edge
+};
+
+class PixelShift {
+public:
+  // Takes the column offset the display was set up with as the centre
+  void begin(U8G2& display, const PixelShiftConfig& config);
+  // Out of range values are clamped. Disabling moves back to the centre.
+  void configure(const PixelShiftConfig& config);
+  const PixelShiftConfig& config() const { return settings; }
+
+  // Takes the next step once the interval is up. Column steps send the
+  // display buffer, so pass `bufferShown` false while it isn't what the
+  // panel shows (a transition is blending) and the step waits.
+  // Returns true if it moved.
+  bool update(U8G2& display, PanelEffects& effects, unsigned long nowMs, bool bufferShown);
+  // The panel was re-initialised, clear the margins again
+  void invalidate() { marginsClear = false; }
+
+  int8_t dx() const { return x; }
+  int8_t dy() const { return y; }
+
+  const PixelShiftStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  void clearMargins(U8G2& display);
+
+  PixelShiftConfig settings = PIXEL_SHIFT_DEFAULTS;
+  uint8_t baseOffset = 0;
+  uint16_t step = 0;
+  int8_t x = 0;
+  int8_t y = 0;
+  unsigned long lastStepMs = 0;
+  bool moved = false;        // Settings changed, go to the right position now
+  bool marginsClear = false;
+  PixelShiftStats perf = {};
+};
+
+#endif
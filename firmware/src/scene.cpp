@@ -0,0 +1,450 @@
+#include "scene.h"
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#include "sprite.h"
+
+static const uint8_t* const FONTS[SCENE_FONT_COUNT] = {
+  u8g2_font_6x10_tf,
+  u8g2_font_7x13B_tf,
+  u8g2_font_10x20_tf,
+};
+
+static int16_t read16(const uint8_t* p) {
+  return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// The running scene is only replaced once the new one has passed every check
+bool ScenePlayer::load(const uint8_t* data, size_t size) {
+  SceneHeader header;
+  if (size < sizeof(header)) {
+    lastError = "scene too short";
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, "TABS", 4) != 0 || header.version != SCENE_VERSION) {
+    lastError = "not a scene or wrong version";
+    return false;
+  }
+  if (header.varCount > SCENE_VAR_COUNT) {
+    lastError = "too many variables";
+    return false;
+  }
+  if (header.codeSize == 0 || sizeof(header) + header.codeSize != size || size > SCENE_MAX_BYTES) {
+    lastError = "scene size mismatch";
+    return false;
+  }
+
+  if (!verify(header, data + sizeof(header))) {
+    return false;
+  }
+
+  unload();
+  memcpy(program, data, size);
+  codeSize = header.codeSize;
+  lastError = "";
+  restart();
+  return true;
+}
+
+void ScenePlayer::unload() {
+  codeSize = 0;
+  done = true;
+}
+
+// Instruction layouts after the op byte: o operand, c coordinate or size
+// operand, f font, t text (length byte and chars), s sprite, b blend, p face
+// parameter, v variable, e ease
+static const char* const LAYOUTS[] = {
+  "",        // SCENE_END
+  "o",       // SCENE_SHOW
+  "",        // SCENE_CLEAR
+  "o",       // SCENE_COLOR
+  "cc",      // SCENE_PIXEL
+  "cccc",    // SCENE_LINE
+  "cccc",    // SCENE_RECT
+  "cccc",    // SCENE_BOX
+  "ccc",     // SCENE_CIRCLE
+  "ccc",     // SCENE_DISC
+  "ccft",    // SCENE_TEXT
+  "ccfo",    // SCENE_NUMBER
+  "sbcc",    // SCENE_SPRITE
+  "",        // SCENE_EYES
+  "po",      // SCENE_FACE
+  "ccccoo",  // SCENE_BAR
+  "vo",      // SCENE_SET
+  "vo",      // SCENE_ADD
+  "veoo",    // SCENE_TWEEN
+  "o",       // SCENE_LOOP
+  "",        // SCENE_NEXT
+};
+
+// Walks every instruction once: lengths, operand ranges and loop nesting.
+// After this the interpreter can't read past the code or overflow its stacks,
+// and no literal shape is big enough to keep U8g2 busy for long.
+bool ScenePlayer::verify(const SceneHeader& header, const uint8_t* body) {
+  uint16_t size = header.codeSize;
+  uint8_t depth = 0;
+  uint16_t at = 0;
+
+  while (at < size) {
+    uint8_t op = body[at++];
+    if (op >= sizeof(LAYOUTS) / sizeof(LAYOUTS[0])) {
+      lastError = "unknown op";
+      return false;
+    }
+
+    for (const char* field = LAYOUTS[op]; *field; field++) {
+      uint16_t width = *field == 'o' || *field == 'c' ? 2 : 1;
+      if (at + width > size) {
+        lastError = "truncated instruction";
+        return false;
+      }
+      uint8_t value = body[at];
+      bool ok = true;
+      switch (*field) {
+        case 'o':
+        case 'c': {
+          int16_t operand = read16(body + at);
+          if (((uint16_t)operand & SCENE_VAR_REF_MASK) == SCENE_VAR_REF) {
+            ok = (operand & 0xff) < header.varCount;
+          } else if (*field == 'c') {
+            ok = operand >= SCENE_COORD_MIN && operand <= SCENE_COORD_MAX;
+          }
+          break;
+        }
+        case 'f':
+          ok = value < SCENE_FONT_COUNT;
+          break;
+        case 't':
+          width += value;
+          ok = at + width <= size;
+          break;
+        case 's':
+          ok = value < FACE_SPRITE_COUNT;
+          break;
+        case 'b':
+          ok = value <= SPRITE_XOR;
+          break;
+        case 'p':
+          ok = value < FACE_PARAM_COUNT;
+          break;
+        case 'v':
+          ok = value < header.varCount;
+          break;
+        case 'e':
+          ok = value <= FACE_EASE_STEP;
+          break;
+      }
+      if (!ok) {
+        lastError = "bad operand";
+        return false;
+      }
+      at += width;
+    }
+
+    if (op == SCENE_LOOP && ++depth > SCENE_MAX_LOOP_DEPTH) {
+      lastError = "loops nested too deep";
+      return false;
+    }
+    if (op == SCENE_NEXT) {
+      if (depth == 0) {
+        lastError = "next without loop";
+        return false;
+      }
+      depth--;
+    }
+  }
+
+  if (depth != 0) {
+    lastError = "loop without next";
+    return false;
+  }
+  return true;
+}
+
+void ScenePlayer::restart() {
+  pc = 0;
+  done = !isLoaded();
+  waiting = false;
+  loopDepth = 0;
+  memset(vars, 0, sizeof(vars));
+  memset(tweens, 0, sizeof(tweens));
+  faceNeutral(&face);
+}
+
+void ScenePlayer::resetStats() {
+  perf = {};
+}
+
+void ScenePlayer::stop(const char* reason) {
+  lastError = reason;
+  done = true;
+}
+
+int16_t ScenePlayer::readOperand() {
+  int16_t value = read16(code + pc);
+  pc += 2;
+  if (((uint16_t)value & SCENE_VAR_REF_MASK) == SCENE_VAR_REF) {
+    return vars[value & 0xff];
+  }
+  return value;
+}
+
+// Literals were checked on load, variables can hold anything
+int16_t ScenePlayer::readCoord() {
+  int16_t value = readOperand();
+  return value < SCENE_COORD_MIN ? SCENE_COORD_MIN : (value > SCENE_COORD_MAX ? SCENE_COORD_MAX : value);
+}
+
+void ScenePlayer::updateTweens(unsigned long nowMs) {
+  for (Tween& tween : tweens) {
+    if (!tween.active) {
+      continue;
+    }
+    uint32_t elapsed = nowMs - tween.start;
+    if (elapsed >= tween.durationMs) {
+      vars[tween.var] = tween.to;
+      tween.active = false;
+    } else {
+      float t = faceEase(tween.ease, (float)elapsed / tween.durationMs);
+      vars[tween.var] = tween.from + (int16_t)lroundf((tween.to - tween.from) * t);
+    }
+  }
+}
+
+// A variable has at most one tween. With all slots busy it jumps to the target.
+void ScenePlayer::startTween(uint8_t var, uint8_t ease, int16_t target, uint16_t durationMs, unsigned long nowMs) {
+  Tween* slot = nullptr;
+  for (Tween& tween : tweens) {
+    if (tween.active && tween.var == var) {
+      slot = &tween;
+      break;
+    }
+    if (!tween.active && !slot) {
+      slot = &tween;
+    }
+  }
+  if (!slot || durationMs == 0) {
+    if (slot) {
+      slot->active = false;
+    }
+    vars[var] = target;
+    return;
+  }
+  *slot = {true, var, ease, vars[var], target, durationMs, nowMs};
+}
+
+bool ScenePlayer::update(U8G2& display, unsigned long nowMs) {
+  if (done) {
+    return false;
+  }
+  if (waiting && (long)(nowMs - resumeAt) < 0) {
+    return false;
+  }
+  // Waits count from when the last one ended, so timers in scenes don't drift
+  unsigned long frameStart = waiting ? resumeAt : nowMs;
+  waiting = false;
+  updateTweens(nowMs);
+
+  unsigned long start = micros();
+  uint8_t* buffer = display.getBufferPtr();
+  uint16_t ops = 0;
+  bool frameReady = false;
+
+  while (!frameReady && !done) {
+    if (pc >= codeSize) {
+      done = true;
+      frameReady = true;
+      break;
+    }
+    if (++ops > SCENE_MAX_OPS) {
+      stop("too many ops without show");
+      break;
+    }
+
+    uint8_t op = readByte();
+    switch (op) {
+      case SCENE_END:
+        done = true;
+        frameReady = true;
+        break;
+      case SCENE_SHOW: {
+        int16_t ms = readOperand();
+        resumeAt = frameStart + (ms > 0 ? ms : 0);
+        // Too far behind to catch up, start counting from now
+        if ((long)(nowMs - resumeAt) > 0) {
+          resumeAt = nowMs;
+        }
+        waiting = true;
+        frameReady = true;
+        break;
+      }
+      case SCENE_CLEAR:
+        display.clearBuffer();
+        break;
+      case SCENE_COLOR: {
+        int16_t color = readOperand();
+        display.setDrawColor(color >= 0 && color <= 2 ? color : 1);
+        break;
+      }
+      case SCENE_PIXEL: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        display.drawPixel(x, y);
+        break;
+      }
+      case SCENE_LINE: {
+        int16_t x0 = readCoord();
+        int16_t y0 = readCoord();
+        int16_t x1 = readCoord();
+        int16_t y1 = readCoord();
+        display.drawLine(x0, y0, x1, y1);
+        break;
+      }
+      case SCENE_RECT:
+      case SCENE_BOX: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        int16_t w = readCoord();
+        int16_t h = readCoord();
+        if (w > 0 && h > 0) {
+          if (op == SCENE_RECT) {
+            display.drawFrame(x, y, w, h);
+          } else {
+            display.drawBox(x, y, w, h);
+          }
+        }
+        break;
+      }
+      case SCENE_CIRCLE:
+      case SCENE_DISC: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        int16_t r = readCoord();
+        if (r >= 0) {
+          if (op == SCENE_CIRCLE) {
+            display.drawCircle(x, y, r);
+          } else {
+            display.drawDisc(x, y, r);
+          }
+        }
+        break;
+      }
+      case SCENE_TEXT: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        uint8_t font = readByte();
+        uint8_t length = readByte();
+        char text[256];
+        memcpy(text, code + pc, length);
+        text[length] = 0;
+        pc += length;
+        display.setFont(FONTS[font]);
+        display.drawStr(x, y, text);
+        break;
+      }
+      case SCENE_NUMBER: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        uint8_t font = readByte();
+        int16_t value = readOperand();
+        char text[8];
+        snprintf(text, sizeof(text), "%d", value);
+        display.setFont(FONTS[font]);
+        display.drawStr(x, y, text);
+        break;
+      }
+      case SCENE_SPRITE: {
+        uint8_t id = readByte();
+        uint8_t blend = readByte();
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        spriteDraw(buffer, *faceSprite(id), x, y, blend);
+        break;
+      }
+      case SCENE_EYES:
+        faceDraw(face, buffer);
+        break;
+      case SCENE_FACE: {
+        uint8_t param = readByte();
+        face.values[param] = readOperand();
+        break;
+      }
+      case SCENE_BAR: {
+        int16_t x = readCoord();
+        int16_t y = readCoord();
+        int16_t w = readCoord();
+        int16_t h = readCoord();
+        int16_t value = readOperand();
+        int16_t max = readOperand();
+        if (w > 4 && h > 4) {
+          display.drawFrame(x, y, w, h);
+          value = value < 0 ? 0 : (value > max ? max : value);
+          int16_t fill = max > 0 ? (int32_t)(w - 4) * value / max : 0;
+          if (fill > 0) {
+            display.drawBox(x + 2, y + 2, fill, h - 4);
+          }
+        }
+        break;
+      }
+      case SCENE_SET: {
+        uint8_t var = readByte();
+        int16_t value = readOperand();
+        startTween(var, FACE_EASE_STEP, value, 0, nowMs);
+        break;
+      }
+      case SCENE_ADD: {
+        uint8_t var = readByte();
+        int16_t value = readOperand();
+        vars[var] += value;
+        break;
+      }
+      case SCENE_TWEEN: {
+        uint8_t var = readByte();
+        uint8_t ease = readByte();
+        int16_t target = readOperand();
+        int16_t ms = readOperand();
+        startTween(var, ease, target, ms > 0 ? ms : 0, nowMs);
+        break;
+      }
+      case SCENE_LOOP: {
+        int16_t count = readOperand();
+        loops[loopDepth++] = {pc, (int16_t)(count == 0 ? -1 : (count < 0 ? 1 : count))};
+        break;
+      }
+      case SCENE_NEXT: {
+        Loop& loop = loops[loopDepth - 1];
+        if (loop.remaining < 0 || --loop.remaining > 0) {
+          pc = loop.start;
+        } else {
+          loopDepth--;
+        }
+        break;
+      }
+    }
+  }
+
+  // Other screens draw with color 1
+  display.setDrawColor(1);
+
+  uint32_t elapsed = micros() - start;
+  perf.lastRunUs = elapsed;
+  perf.totalRunUs += elapsed;
+  if (elapsed > perf.maxRunUs) {
+    perf.maxRunUs = elapsed;
+  }
+  perf.lastOps = ops;
+  if (ops > perf.maxOps) {
+    perf.maxOps = ops;
+  }
+  if (elapsed > SCENE_BUDGET_US) {
+    perf.overBudget++;
+  }
+  if (frameReady) {
+    perf.frames++;
+  }
+  return frameReady;
+}
@@ -0,0 +1,149 @@
+// Scene bytecode ("TABS" blob)
+// A scene is a small program that draws into the U8g2 buffer: primitives,
+// text, sprites, the procedural eyes, loops, waits and animated variables.
+// It is compiled on the PC by tools/scenec.py and uploaded once, instead of
+// streaming a frame per update. The program is checked completely when it
+// is loaded; running it is bounded by SCENE_MAX_OPS between two frames and
+// SCENE_MAX_LOOP_DEPTH nested loops, so a bad scene can't hang the loop.
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <U8g2lib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "face_renderer.h"
+
+#define SCENE_VERSION 1
+#define SCENE_MAX_BYTES 2048
+#define SCENE_VAR_COUNT 16
+#define SCENE_MAX_LOOP_DEPTH 4
+#define SCENE_MAX_TWEENS 4
+#define SCENE_MAX_OPS 256        // Ops run between two SHOWs before the scene is stopped
+#define SCENE_BUDGET_US 10000    // Drawing a frame longer than this counts as over budget
+// Coordinates, sizes and radii, a screen's width around it. U8g2 takes a
+// step per pixel of a shape's size, clipped or not.
+#define SCENE_COORD_MIN -128
+#define SCENE_COORD_MAX 255
+
+// Operands are little endian int16. 0x8000 + n reads variable n instead,
+// every other value is used as is.
+#define SCENE_VAR_REF 0x8000
+#define SCENE_VAR_REF_MASK 0xff00
+
+enum SceneOp : uint8_t {
+  SCENE_END = 0x00,     //                              stop, the animation returns to idle
+  SCENE_SHOW = 0x01,    // ms                           send the frame, continue after ms
+  SCENE_CLEAR = 0x02,   //
+  SCENE_COLOR = 0x03,   // color                        0 clear, 1 set, 2 xor
+  SCENE_PIXEL = 0x04,   // x y
+  SCENE_LINE = 0x05,    // x0 y0 x1 y1
+  SCENE_RECT = 0x06,    // x y w h                      outline
+  SCENE_BOX = 0x07,     // x y w h                      filled
+  SCENE_CIRCLE = 0x08,  // x y r
+  SCENE_DISC = 0x09,    // x y r
+  SCENE_TEXT = 0x0a,    // x y u8:font u8:length chars  baseline at y
+  SCENE_NUMBER = 0x0b,  // x y u8:font value
+  SCENE_SPRITE = 0x0c,  // u8:sprite u8:blend x y       FaceSprite ids, SpriteBlend modes
+  SCENE_EYES = 0x0d,    //                              procedural eyes from the face parameters
+  SCENE_FACE = 0x0e,    // u8:param value               sets a FaceParam
+  SCENE_BAR = 0x0f,     // x y w h value max            progress bar
+  SCENE_SET = 0x10,     // u8:var value
+  SCENE_ADD = 0x11,     // u8:var value
+  SCENE_TWEEN = 0x12,   // u8:var u8:ease target ms     animates a variable, doesn't wait
+  SCENE_LOOP = 0x13,    // count                        0 repeats forever
+  SCENE_NEXT = 0x14     //                              end of the loop body
+};
+
+enum SceneFont : uint8_t {
+  SCENE_FONT_SMALL = 0,   // 6x10
+  SCENE_FONT_MEDIUM,      // 7x13 bold
+  SCENE_FONT_LARGE,       // 10x20
+  SCENE_FONT_COUNT
+};
+
+struct SceneHeader {
+  char magic[4];  // "TABS"
+  uint8_t version;
+  uint8_t varCount;
+  uint16_t codeSize;
+};
+
+static_assert(sizeof(SceneHeader) == 8, "scene header layout");
+
+struct SceneStats {
+  uint32_t frames;
+  uint32_t lastRunUs;
+  uint32_t maxRunUs;
+  uint64_t totalRunUs;
+  uint16_t lastOps;
+  uint16_t maxOps;
+  uint32_t overBudget;
+};
+
+class ScenePlayer {
+public:
+  // Verifies a scene and copies it in, returns false with error() set and the
+  // current scene kept if it is malformed
+  bool load(const uint8_t* data, size_t size);
+  void unload();
+  bool isLoaded() const { return codeSize > 0; }
+  const uint8_t* data() const { return program; }
+  size_t size() const { return isLoaded() ? sizeof(SceneHeader) + codeSize : 0; }
+  const char* error() const { return lastError; }
+
+  // Starts from the top with fresh variables and face parameters
+  void restart();
+
+  // Runs the program up to its next SHOW once the last wait is over, drawing
+  // into the display buffer. Returns true when a frame is ready to send.
+  bool update(U8G2& display, unsigned long nowMs);
+  bool finished() const { return done; }
+
+  const SceneStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  bool verify(const SceneHeader& header, const uint8_t* body);
+  uint8_t readByte() { return code[pc++]; }
+  int16_t readOperand();
+  int16_t readCoord();
+  void updateTweens(unsigned long nowMs);
+  void startTween(uint8_t var, uint8_t ease, int16_t target, uint16_t durationMs, unsigned long nowMs);
+  void stop(const char* reason);
+
+  struct Loop {
+    uint16_t start;
+    int16_t remaining;  // < 0 repeats forever
+  };
+
+  struct Tween {
+    bool active;
+    uint8_t var;
+    uint8_t ease;
+    int16_t from;
+    int16_t to;
+    uint16_t durationMs;
+    unsigned long start;
+  };
+
+  uint8_t program[SCENE_MAX_BYTES];
+  const uint8_t* code = program + sizeof(SceneHeader);
+  uint16_t codeSize = 0;
+  const char* lastError = "";
+
+  uint16_t pc = 0;
+  bool done = true;
+  bool waiting = false;
+  unsigned long resumeAt = 0;
+  int16_t vars[SCENE_VAR_COUNT];
+  Loop loops[SCENE_MAX_LOOP_DEPTH];
+  uint8_t loopDepth = 0;
+  Tween tweens[SCENE_MAX_TWEENS];
+  FaceParams face;
+
+  SceneStats perf = {};
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "sprite.h"
+
+#include "anim_pack.h"
+
+static inline void blend8(uint8_t* dst, uint8_t bits, uint8_t mask, uint8_t blend) {
+  switch (blend) {
+    case SPRITE_OR:
+      *dst |= bits;
+      break;
+    case SPRITE_AND:
+      *dst &= bits | ~mask;
+      break;
+    case SPRITE_XOR:
+      *dst ^= bits;
+      break;
+    default:
+      *dst = (*dst & ~mask) | bits;
+      break;
+  }
+}
+
+void spriteDraw(uint8_t* frame, const Sprite& sprite, int x, int y, uint8_t blend) {
+  int width = sprite.width;
+  int height = sprite.height > ANIM_FRAME_HEIGHT ? ANIM_FRAME_HEIGHT : sprite.height;
+  if (!sprite.bits || height == 0 || x >= ANIM_FRAME_WIDTH || x + width <= 0 ||
+      y >= ANIM_FRAME_HEIGHT || y + height <= 0) {
+    return;
+  }
+
+  int pages = (height + 7) / 8;
+  uint64_t rows = height >= 64 ? ~0ULL : (1ULL << height) - 1;
+  int firstPage = (y < 0 ? 0 : y) >> 3;
+  int lastPage = (y + height > ANIM_FRAME_HEIGHT ? ANIM_FRAME_HEIGHT - 1 : y + height - 1) >> 3;
+  int firstColumn = x < 0 ? -x : 0;
+  int lastColumn = x + width > ANIM_FRAME_WIDTH ? ANIM_FRAME_WIDTH - x : width;
+
+  for (int sx = firstColumn; sx < lastColumn; sx++) {
+    uint64_t bits = 0;
+    uint64_t mask = sprite.mask ? 0 : rows;
+    for (int page = 0; page < pages; page++) {
+      bits |= (uint64_t)sprite.bits[page * width + sx] << (page * 8);
+      if (sprite.mask) {
+        mask |= (uint64_t)sprite.mask[page * width + sx] << (page * 8);
+      }
+    }
+    mask &= rows;
+    bits &= mask;
+    if (y >= 0) {
+      bits <<= y;
+      mask <<= y;
+    } else {
+      bits >>= -y;
+      mask >>= -y;
+    }
+
+    uint8_t* column = frame + x + sx;
+    for (int page = firstPage; page <= lastPage; page++) {
+      uint8_t pageMask = (uint8_t)(mask >> (page * 8));
+      if (pageMask) {
+        blend8(&column[page * ANIM_FRAME_WIDTH], (uint8_t)(bits >> (page * 8)), pageMask, blend);
+      }
+    }
+  }
+}
+
+void spriteComposite(uint8_t* frame, const SpriteLayer* layers, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (layers[i].sprite) {
+      spriteDraw(frame, *layers[i].sprite, layers[i].x, layers[i].y, layers[i].blend);
+    }
+  }
+}
@@ -0,0 +1,40 @@
+// Masked 1bpp sprites composited into a page-format frame
+// Sprites use the same page layout as frames (see anim_pack.h), so x is just
+// a column offset and the unaligned axis is y: each sprite column is gathered
+// into one 64 bit word, shifted into place once and applied to the pages it
+// covers with shift-and-mask instead of per-pixel drawPixel().
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum SpriteBlend : uint8_t {
+  SPRITE_MASK = 0,  // Replace the pixels under the mask
+  SPRITE_OR,        // Set lit pixels
+  SPRITE_AND,       // Clear unlit pixels under the mask
+  SPRITE_XOR        // Invert under lit pixels
+};
+
+struct Sprite {
+  uint8_t width;
+  uint8_t height;       // Up to 64
+  const uint8_t* bits;  // (height + 7) / 8 pages of `width` bytes
+  const uint8_t* mask;  // Same layout, nullptr covers the whole rectangle
+};
+
+struct SpriteLayer {
+  const Sprite* sprite;
+  int16_t x;
+  int16_t y;
+  uint8_t blend;
+};
+
+// x/y may be partly or fully off screen
+void spriteDraw(uint8_t* frame, const Sprite& sprite, int x, int y, uint8_t blend);
+
+// Draws the layers bottom to top
+void spriteComposite(uint8_t* frame, const SpriteLayer* layers, size_t count);
+
+#endif
@@ -0,0 +1,191 @@
+#include "text.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Glyph cells - generated from the U8g2 fonts by tools/build_glyphs.py
+#include "generated/glyph_atlas_data.h"
+
+// Characters outside the atlas draw as a space
+static inline uint8_t glyphIndex(const GlyphFont& font, char c) {
+  uint8_t index = (uint8_t)c - font.first;
+  return index < font.count ? index : (uint8_t)(' ' - font.first);
+}
+
+uint16_t textWidth(const GlyphFont& font, const char* text) {
+  uint16_t width = 0;
+  for (const char* p = text; *p; p++) {
+    width += font.widths[glyphIndex(font, *p)];
+  }
+  return width;
+}
+
+uint32_t textAtlasBytes(const GlyphFont& font) {
+  uint8_t last = font.count - 1;
+  return font.offsets[last] + font.widths[last] * ((font.height + 7) / 8);
+}
+
+// ORs columns from..to - 1 of a page-format image `srcWidth` columns wide
+// into a page-format destination, the image's column 0 at x and its top at
+// row `top`. Glyph cells go into frames, and into marquee strips.
+static void blitColumns(uint8_t* dst, int dstWidth, int dstPages, const uint8_t* src, int srcWidth, int pages,
+                        int x, int top, int from, int to) {
+  if (top >= 0 && (top & 7) == 0) {
+    for (int page = 0; page < pages && (top >> 3) + page < dstPages; page++) {
+      uint8_t* out = dst + ((top >> 3) + page) * dstWidth + x;
+      const uint8_t* in = src + page * srcWidth;
+      for (int c = from; c < to; c++) {
+        out[c] |= in[c];
+      }
+    }
+    return;
+  }
+
+  // At most 3 pages shifted by up to 7 rows fit one word
+  int firstPage = top >> 3;
+  for (int c = from; c < to; c++) {
+    uint32_t column = 0;
+    for (int page = 0; page < pages; page++) {
+      column |= (uint32_t)src[page * srcWidth + c] << (page * 8);
+    }
+    column = top >= 0 ? column << (top & 7) : column >> -top;
+    for (int page = top >= 0 ? firstPage : 0; column && page < dstPages; page++) {
+      dst[page * dstWidth + x + c] |= (uint8_t)column;
+      column >>= 8;
+    }
+  }
+}
+
+int textDraw(uint8_t* frame, const GlyphFont& font, int x, int y, const char* text, int clipLeft, int clipRight) {
+  int top = y - font.ascent;
+  int pages = (font.height + 7) / 8;
+  if (clipLeft < 0) {
+    clipLeft = 0;
+  }
+  if (clipRight > ANIM_FRAME_WIDTH) {
+    clipRight = ANIM_FRAME_WIDTH;
+  }
+  bool visible = top < ANIM_FRAME_HEIGHT && top + font.height > 0;
+
+  for (const char* p = text; *p; p++) {
+    uint8_t index = glyphIndex(font, *p);
+    int width = font.widths[index];
+    if (visible && x < clipRight && x + width > clipLeft) {
+      int from = x < clipLeft ? clipLeft - x : 0;
+      int to = x + width > clipRight ? clipRight - x : width;
+      blitColumns(frame, ANIM_FRAME_WIDTH, ANIM_FRAME_HEIGHT / 8, font.bits + font.offsets[index], width, pages, x,
+                  top, from, to);
+    }
+    x += width;
+  }
+  return x;
+}
+
+TextMarquee::~TextMarquee() {
+  free(strip);
+}
+
+void TextMarquee::configure(const MarqueeConfig& config) {
+  settings = config;
+  if (settings.mode >= MARQUEE_MODE_COUNT) {
+    settings.mode = MARQUEE_LOOP;
+  }
+  if (settings.pxPerS == 0) {
+    settings.pxPerS = 1;
+  }
+}
+
+uint32_t TextMarquee::stripBytes() const {
+  return strip ? measured * ((font->height + 7) / 8) : 0;
+}
+
+void TextMarquee::set(const GlyphFont& textFont, const char* text, unsigned long nowMs) {
+  if (font == &textFont && strncmp(line, text, TEXT_MARQUEE_MAX) == 0) {
+    return;
+  }
+  font = &textFont;
+  strncpy(line, text, TEXT_MARQUEE_MAX);
+  line[TEXT_MARQUEE_MAX] = '\0';
+  measured = textWidth(textFont, line);
+  startMs = nowMs;
+
+  free(strip);
+  int pages = (textFont.height + 7) / 8;
+  strip = measured ? (uint8_t*)calloc(measured, pages) : nullptr;
+  if (!strip) {
+    return;
+  }
+  int x = 0;
+  for (const char* p = line; *p; p++) {
+    uint8_t index = glyphIndex(textFont, *p);
+    uint8_t width = textFont.widths[index];
+    blitColumns(strip, measured, pages, textFont.bits + textFont.offsets[index], width, pages, x, 0, 0, width);
+    x += width;
+  }
+  stripRenders++;
+}
+
+// Pixels scrolled at nowMs, only called for text wider than the box
+int TextMarquee::scrollOffset(uint16_t boxWidth, unsigned long nowMs) const {
+  uint32_t elapsed = nowMs - startMs;
+  uint32_t pause = settings.pauseMs;
+
+  if (settings.mode == MARQUEE_BOUNCE) {
+    uint32_t travel = measured - boxWidth;
+    uint32_t half = pause + travel * 1000 / settings.pxPerS;
+    uint32_t t = half ? elapsed % (2 * half) : 0;
+    bool back = t >= half;
+    if (back) {
+      t -= half;
+    }
+    uint32_t moved = t < pause ? 0 : (uint64_t)(t - pause) * settings.pxPerS / 1000;
+    if (moved > travel) {
+      moved = travel;
+    }
+    return back ? travel - moved : moved;
+  }
+
+  uint32_t lap = measured + settings.gapPx;
+  uint32_t cycle = pause + lap * 1000 / settings.pxPerS;
+  uint32_t t = cycle ? elapsed % cycle : 0;
+  uint32_t moved = t < pause ? 0 : (uint64_t)(t - pause) * settings.pxPerS / 1000;
+  return moved < lap ? moved : lap - 1;
+}
+
+// The whole text with its start at x, clipped to the box
+void TextMarquee::drawAt(uint8_t* frame, int x, int y, int clipLeft, int clipRight) const {
+  if (!strip) {
+    textDraw(frame, *font, x, y, line, clipLeft, clipRight);
+    return;
+  }
+  int top = y - font->ascent;
+  if (clipLeft < 0) {
+    clipLeft = 0;
+  }
+  if (clipRight > ANIM_FRAME_WIDTH) {
+    clipRight = ANIM_FRAME_WIDTH;
+  }
+  int from = x < clipLeft ? clipLeft - x : 0;
+  int to = x + measured > clipRight ? clipRight - x : measured;
+  if (from < to && top < ANIM_FRAME_HEIGHT && top + font->height > 0) {
+    blitColumns(frame, ANIM_FRAME_WIDTH, ANIM_FRAME_HEIGHT / 8, strip, measured, (font->height + 7) / 8, x, top, from,
+                to);
+  }
+}
+
+void TextMarquee::draw(uint8_t* frame, int x, int y, uint16_t boxWidth, unsigned long nowMs) const {
+  if (!font) {
+    return;
+  }
+  if (!scrolls(boxWidth)) {
+    drawAt(frame, x, y, x, x + boxWidth);
+    return;
+  }
+
+  int offset = scrollOffset(boxWidth, nowMs);
+  drawAt(frame, x - offset, y, x, x + boxWidth);
+  if (settings.mode == MARQUEE_LOOP) {
+    // The next lap coming in from the right
+    drawAt(frame, x - offset + measured + settings.gapPx, y, x, x + boxWidth);
+  }
+}
@@ -0,0 +1,100 @@
+// Text from pre-rendered glyphs
+// drawStr() decodes every glyph of U8g2's run-length fonts pixel by pixel,
+// on every frame. tools/glyphatlas.py decodes the fonts once at build time
+// into cells in page format (see anim_pack.h), so a string is drawn by
+// OR'ing glyph columns into the frame: plain byte copies when the text's
+// top is on a page boundary, one shift per column otherwise. Widths come
+// from the same tables, so measuring is a lookup per character.
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdint.h>
+
+#include "anim_pack.h"
+
+struct GlyphFont {
+  uint8_t first;            // First character in the atlas
+  uint8_t count;
+  uint8_t height;           // Cell height, px, at most 24
+  uint8_t ascent;           // Cell rows above the baseline
+  const uint8_t* widths;    // Advance of each glyph, its cell is as wide
+  const uint16_t* offsets;  // Of each glyph's cell in bits
+  const uint8_t* bits;      // (height + 7) / 8 pages of `width` bytes per glyph
+};
+
+// Generated from these U8g2 fonts - must match FONTS in tools/glyphatlas.py
+extern const GlyphFont GLYPH_FONT_6X10;   // u8g2_font_6x10_tf
+extern const GlyphFont GLYPH_FONT_10X20;  // u8g2_font_10x20_tf
+
+uint16_t textWidth(const GlyphFont& font, const char* text);
+// ORs the text into the frame with its baseline at y, like drawStr(), only
+// touching columns clipLeft..clipRight - 1. Returns the x after the text.
+int textDraw(uint8_t* frame, const GlyphFont& font, int x, int y, const char* text, int clipLeft = 0,
+             int clipRight = ANIM_FRAME_WIDTH);
+// Flash taken by the font's glyphs
+uint32_t textAtlasBytes(const GlyphFont& font);
+
+// Longer text is cut, task names are far shorter
+#define TEXT_MARQUEE_MAX 96
+// How often scrolling text needs drawing, 30 fps
+#define TEXT_MARQUEE_FRAME_MS 33
+
+enum MarqueeMode : uint8_t {
+  MARQUEE_LOOP = 0,  // Runs out to the left and comes round again after a gap
+  MARQUEE_BOUNCE,    // Scrolls until its end shows, then back
+  MARQUEE_MODE_COUNT
+};
+
+struct MarqueeConfig {
+  uint8_t mode;
+  uint16_t pxPerS;
+  uint16_t pauseMs;  // Held with the start showing, and the end when bouncing
+  uint16_t gapPx;    // Blank between laps when looping
+};
+
+#define MARQUEE_DEFAULTS {MARQUEE_LOOP, 30, 1500, 24}
+
+// A line of text in a box, scrolling through it when it doesn't fit. The
+// text is rendered once into an off-screen strip in page format when it
+// changes, and each frame copies the box's window of the strip.
+class TextMarquee {
+public:
+  TextMarquee() = default;
+  TextMarquee(const TextMarquee&) = delete;
+  TextMarquee& operator=(const TextMarquee&) = delete;
+  ~TextMarquee();
+
+  void configure(const MarqueeConfig& config);
+  const MarqueeConfig& config() const { return settings; }
+
+  // Keeps the text, its width and its strip, which only change when the
+  // text does. A new text starts scrolling from the beginning.
+  void set(const GlyphFont& font, const char* text, unsigned long nowMs);
+  const char* text() const { return line; }
+  uint16_t width() const { return measured; }
+  bool scrolls(uint16_t boxWidth) const { return measured > boxWidth; }
+
+  // Draws into the box starting at x, baseline at y
+  void draw(uint8_t* frame, int x, int y, uint16_t boxWidth, unsigned long nowMs) const;
+
+  // Strip renders, and the heap the current strip takes
+  uint32_t renders() const { return stripRenders; }
+  uint32_t stripBytes() const;
+
+private:
+  int scrollOffset(uint16_t boxWidth, unsigned long nowMs) const;
+  void drawAt(uint8_t* frame, int x, int y, int clipLeft, int clipRight) const;
+
+  MarqueeConfig settings = MARQUEE_DEFAULTS;
+  const GlyphFont* font = nullptr;
+  char line[TEXT_MARQUEE_MAX + 1] = "";
+  uint16_t measured = 0;
+  unsigned long startMs = 0;
+  // `measured` columns of (height + 7) / 8 pages, glyphs are drawn one by
+  // one if it couldn't be allocated
+  uint8_t* strip = nullptr;
+  uint32_t stripRenders = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "transition.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "host/host_time.h"
+#endif
+#include <string.h>
+
+// Checked in order. The eye clips morph into each other, everything else dithers.
+static const TransitionRule TRANSITIONS[] = {
+  {"setup", "*", ANIM_BLEND_NONE, 0},
+  {"*", "setup", ANIM_BLEND_NONE, 0},
+  {"*", "debug", ANIM_BLEND_NONE, 0},
+  {"startup", "idle", ANIM_BLEND_DITHER, 600},
+  {"idle", "focus", ANIM_BLEND_MORPH, 400},
+  {"idle", "break", ANIM_BLEND_MORPH, 400},
+  {"focus", "idle", ANIM_BLEND_MORPH, 400},
+  {"focus", "break", ANIM_BLEND_MORPH, 500},
+  {"break", "idle", ANIM_BLEND_MORPH, 400},
+  {"break", "focus", ANIM_BLEND_MORPH, 500},
+  {"*", "paused", ANIM_BLEND_DITHER, 250},
+  {"*", "scene", ANIM_BLEND_DITHER, 300},
+  {"*", "*", ANIM_BLEND_DITHER, 400},
+};
+
+static bool matches(const char* pattern, const char* state) {
+  return strcmp(pattern, "*") == 0 || strcmp(pattern, state) == 0;
+}
+
+const TransitionRule* transitionFind(const char* from, const char* to) {
+  for (const TransitionRule& rule : TRANSITIONS) {
+    if (matches(rule.from, from) && matches(rule.to, to)) {
+      return rule.durationMs ? &rule : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+uint8_t Transition::levelAt(unsigned long nowMs) const {
+  uint32_t elapsed = nowMs - startMs;
+  if (elapsed >= durationMs) {
+    return ANIM_BLEND_LEVELS;
+  }
+  return elapsed * ANIM_BLEND_LEVELS / durationMs;
+}
+
+void Transition::begin(const uint8_t* screen, const TransitionRule& rule, unsigned long nowMs) {
+  if (running && sent) {
+    // incoming still holds the frame the blend on screen was made from
+    animBlend(outgoing, incoming, outgoing, mode, lastLevel);
+  } else {
+    memcpy(outgoing, screen, ANIM_FRAME_BYTES);
+  }
+  mode = rule.mode;
+  durationMs = rule.durationMs;
+  startMs = nowMs;
+  lastLevel = 0;
+  running = true;
+  sent = false;
+  perf.transitions++;
+}
+
+bool Transition::finish(unsigned long nowMs) {
+  if (!running || levelAt(nowMs) < ANIM_BLEND_LEVELS) {
+    return false;
+  }
+  running = false;
+  return true;
+}
+
+bool Transition::compose(uint8_t* frame, unsigned long nowMs) {
+  if (!running || (sent && nowMs - lastFrameMs < TRANSITION_FRAME_MS)) {
+    return false;
+  }
+  uint8_t level = levelAt(nowMs);
+  if (sent && level == lastLevel && memcmp(frame, incoming, ANIM_FRAME_BYTES) == 0) {
+    return false;
+  }
+
+  unsigned long start = micros();
+  memcpy(incoming, frame, ANIM_FRAME_BYTES);
+  animBlend(outgoing, incoming, frame, mode, level);
+  uint32_t elapsed = micros() - start;
+
+  perf.frames++;
+  perf.lastBlendUs = elapsed;
+  perf.totalBlendUs += elapsed;
+  if (elapsed > perf.maxBlendUs) {
+    perf.maxBlendUs = elapsed;
+  }
+  lastLevel = level;
+  lastFrameMs = nowMs;
+  sent = true;
+  return true;
+}
+
+void Transition::restore(uint8_t* frame) {
+  memcpy(frame, incoming, ANIM_FRAME_BYTES);
+}
+
+void Transition::resetStats() {
+  memset(&perf, 0, sizeof(perf));
+}
@@ -0,0 +1,76 @@
+// Crossfades between display states
+// When updateDisplay() switches states (idle to focus, focus to break, ...)
+// the screen being left is kept and blended into the incoming state's frames
+// with anim_blend.h, so no transition clips are stored. The incoming state
+// keeps running and drawing into the display buffer as usual; while a
+// transition is active its own sends are held back and the blended frame is
+// sent instead. Rules in transition.cpp pick a blend and a duration for each
+// pair of states; pairs without one cut.
+
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <stdint.h>
+
+#include "anim_blend.h"
+
+// Blended frames are sent at most this often
+#define TRANSITION_FRAME_MS 33
+
+// `from` and `to` are state names as in currentAnimation, plus "startup",
+// "setup" and "debug". "*" matches any state.
+struct TransitionRule {
+  const char* from;
+  const char* to;
+  uint8_t mode;         // AnimBlendMode
+  uint16_t durationMs;  // 0 cuts
+};
+
+// First matching rule, nullptr to cut
+const TransitionRule* transitionFind(const char* from, const char* to);
+
+struct TransitionStats {
+  uint32_t transitions;
+  uint32_t frames;
+  uint32_t lastBlendUs;
+  uint32_t maxBlendUs;
+  uint64_t totalBlendUs;
+};
+
+class Transition {
+public:
+  // Starts blending from `screen`, what the panel shows now. Starting during
+  // a transition continues from the blend currently on screen.
+  void begin(const uint8_t* screen, const TransitionRule& rule, unsigned long nowMs);
+  void cancel() { running = false; }
+  bool active() const { return running; }
+
+  // Ends the transition once its time is up, returns true then
+  bool finish(unsigned long nowMs);
+
+  // If a new blended frame is due, keeps `frame` (the incoming state's
+  // frame) aside, writes the blend into it and returns true. Send it, then
+  // put the incoming frame back with restore().
+  bool compose(uint8_t* frame, unsigned long nowMs);
+  void restore(uint8_t* frame);
+
+  const TransitionStats& stats() const { return perf; }
+  void resetStats();
+
+private:
+  uint8_t levelAt(unsigned long nowMs) const;
+
+  alignas(4) uint8_t outgoing[ANIM_FRAME_BYTES];
+  alignas(4) uint8_t incoming[ANIM_FRAME_BYTES];
+  uint8_t mode = ANIM_BLEND_DITHER;
+  uint16_t durationMs = 0;
+  unsigned long startMs = 0;
+  unsigned long lastFrameMs = 0;
+  uint8_t lastLevel = 0;
+  bool running = false;
+  bool sent = false;
+
+  TransitionStats perf = {};
+};
+
+#endif
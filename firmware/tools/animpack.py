@@ -0,0 +1,860 @@
+#!/usr/bin/env python3
+"""
+Tabbie animation pack compiler
+
+Turns the clip headers in assets/ (Adafruit_GFX row-major bitmaps exported
+from lopaka/video) into one packed "TABP" blob of SH1106 page-format frames.
+
+Every frame is encoded with each codec the firmware understands and the
+smallest encoding whose estimated decode time fits the decode budget wins.
+The chosen codec is written into the frame header, so the firmware never
+has to guess (see src/anim_pack.h for the matching reader).
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+import urllib.error
+import urllib.request
+import zlib
+from pathlib import Path
+
+FRAME_WIDTH = 128
+FRAME_HEIGHT = 64
+FRAME_BYTES = FRAME_WIDTH * FRAME_HEIGHT // 8
+
+PACK_MAGIC = b"TABP"
+PACK_VERSION = 2
+
+HEADER_FORMAT = "<4sHHHHHHIIII"
+CLIP_FORMAT = "<16sHHHBBHH"
+SEGMENT_FORMAT = "<HHBB"
+FRAME_HEADER_FORMAT = "<BBH"
+
+CLIP_FLAG_LOOP = 0x01
+# In-between frames synthesized on the device - must match src/anim_pack.h
+CLIP_FLAGS_INTERPOLATE = {"none": 0, "dither": 0x02, "morph": 0x04}
+SEGMENT_FLAG_REVERSE = 0x01
+FRAME_FLAG_KEY = 0x01
+
+# Play modes - must match AnimPlayMode in src/anim_pack.h
+PLAY_MODES = {"forward": 0, "reverse": 1, "pingpong": 2}
+
+# Shorter repeats aren't worth a segment entry
+MIN_REUSE_FRAMES = 3
+
+# ESP32 flash cache line - frame records are placed so they never touch more
+# lines than their size needs
+CACHE_LINE = 32
+
+# Patch ops for /api/assets/sync - must match src/asset_patch.h
+PATCH_LITERAL = 0x01
+PATCH_COPY = 0x02
+
+# Codec ids - must match AnimCodec in src/anim_pack.h
+CODEC_HOLD = 0
+CODEC_RAW = 1
+CODEC_LZ = 2
+CODEC_XOR = 3
+CODEC_NAMES = {CODEC_HOLD: "hold", CODEC_RAW: "raw", CODEC_LZ: "lz", CODEC_XOR: "xor"}
+
+# Estimated decode cost on the ESP32 at 240 MHz: (fixed us, us per payload byte).
+# These are deliberately pessimistic (flash cache misses included) and can be
+# replaced with numbers measured on the device via --calibration.
+DEFAULT_COST_MODEL = {
+    "hold": (0.0, 0.0),
+    "raw": (4.0, 0.02),
+    "lz": (20.0, 0.25),
+    "xor": (3.0, 0.05),
+}
+
+DEFAULT_BUDGET_US = 250
+
+LZ_MIN_MATCH = 3
+LZ_MAX_MATCH = 18 + 255
+LZ_MAX_DISTANCE = 4095
+LZ_MAX_CANDIDATES = 24
+
+
+# ---------------------------------------------------------------------------
+# Source parsing
+# ---------------------------------------------------------------------------
+
+def parse_clip_header(path):
+    """Return (frames, frame_delay_ms) from a generated clip header"""
+    text = Path(path).read_text(encoding="utf-8")
+
+    frames = []
+    for match in re.finditer(r"(\w+)\s*\[\]\s*=\s*\{([^}]*)\}", text):
+        values = re.findall(r"0x([0-9a-fA-F]{2})", match.group(2))
+        if len(values) != FRAME_BYTES:
+            continue  # frame pointer tables and anything else that isn't a bitmap
+        frames.append(bytes(int(v, 16) for v in values))
+
+    delay = re.search(r"#define\s+\w+_FRAME_DELAY\s+(\d+)", text)
+    return frames, int(delay.group(1)) if delay else 0
+
+
+def to_page_format(bitmap):
+    """Convert a row-major MSB-first bitmap to the U8g2/SH1106 page layout"""
+    page = bytearray(FRAME_BYTES)
+    row_bytes = FRAME_WIDTH // 8
+    for y in range(FRAME_HEIGHT):
+        row = bitmap[y * row_bytes:(y + 1) * row_bytes]
+        base = (y >> 3) * FRAME_WIDTH
+        bit = 1 << (y & 7)
+        for x in range(FRAME_WIDTH):
+            if row[x >> 3] & (0x80 >> (x & 7)):
+                page[base + x] |= bit
+    return bytes(page)
+
+
+# ---------------------------------------------------------------------------
+# Codecs
+# ---------------------------------------------------------------------------
+
+def encode_hold(frame, prev):
+    return b"" if prev == frame else None
+
+
+def encode_raw(frame, prev):
+    return frame
+
+
+def encode_xor(frame, prev):
+    """Sparse XOR delta: [skip][count][count bytes] records against prev"""
+    if prev is None:
+        return None
+
+    diff = bytes(a ^ b for a, b in zip(frame, prev))
+    out = bytearray()
+    pos = 0
+    while True:
+        start = pos
+        while pos < FRAME_BYTES and diff[pos] == 0:
+            pos += 1
+        if pos == FRAME_BYTES:
+            break
+
+        skip = pos - start
+        while skip > 255:
+            out += bytes((255, 0))
+            skip -= 255
+
+        run_start = pos
+        while pos < FRAME_BYTES and pos - run_start < 255:
+            if diff[pos]:
+                pos += 1
+                continue
+            # Swallow short zero gaps - cheaper than a new 2 byte record
+            gap_end = pos
+            while gap_end < FRAME_BYTES and diff[gap_end] == 0:
+                gap_end += 1
+            if gap_end < FRAME_BYTES and gap_end - pos <= 2 and gap_end - run_start <= 255:
+                pos = gap_end
+            else:
+                break
+
+        out += bytes((skip, pos - run_start)) + diff[run_start:pos]
+    return bytes(out)
+
+
+def encode_lz(frame, prev):
+    """LZSS: flag byte per 8 tokens, literal or (12 bit distance, 4 bit length)"""
+    out = bytearray()
+    tokens = []
+    table = {}
+    pos = 0
+    while pos < FRAME_BYTES:
+        best_len, best_dist = 0, 0
+        key = frame[pos:pos + LZ_MIN_MATCH]
+        if len(key) == LZ_MIN_MATCH:
+            for cand in reversed(table.get(key, [])[-LZ_MAX_CANDIDATES:]):
+                dist = pos - cand
+                if dist > LZ_MAX_DISTANCE:
+                    break
+                length = 0
+                limit = min(LZ_MAX_MATCH, FRAME_BYTES - pos)
+                while length < limit and frame[cand + length] == frame[pos + length]:
+                    length += 1
+                if length > best_len:
+                    best_len, best_dist = length, dist
+                    if length == limit:
+                        break
+
+        step = best_len if best_len >= LZ_MIN_MATCH else 1
+        for i in range(pos, min(pos + step, FRAME_BYTES - LZ_MIN_MATCH + 1)):
+            table.setdefault(frame[i:i + LZ_MIN_MATCH], []).append(i)
+
+        if best_len >= LZ_MIN_MATCH:
+            code = min(best_len - LZ_MIN_MATCH, 15)
+            token = bytes((best_dist & 0xFF, (best_dist >> 8) | (code << 4)))
+            if code == 15:
+                token += bytes((best_len - 18,))
+            tokens.append((True, token))
+        else:
+            tokens.append((False, frame[pos:pos + 1]))
+        pos += step
+
+    for group in range(0, len(tokens), 8):
+        chunk = tokens[group:group + 8]
+        flags = 0
+        for bit, (is_match, _) in enumerate(chunk):
+            if is_match:
+                flags |= 1 << bit
+        out.append(flags)
+        for _, token in chunk:
+            out += token
+    return bytes(out)
+
+
+ENCODERS = [
+    (CODEC_HOLD, encode_hold),
+    (CODEC_XOR, encode_xor),
+    (CODEC_LZ, encode_lz),
+    (CODEC_RAW, encode_raw),
+]
+
+
+def decode_lz(payload):
+    """Reference decoder, used to self-check every LZ frame we emit"""
+    out = bytearray()
+    pos = 0
+    while pos < len(payload) and len(out) < FRAME_BYTES:
+        flags = payload[pos]
+        pos += 1
+        for bit in range(8):
+            if pos >= len(payload) or len(out) >= FRAME_BYTES:
+                break
+            if not flags & (1 << bit):
+                out.append(payload[pos])
+                pos += 1
+                continue
+            dist = payload[pos] | ((payload[pos + 1] & 0x0F) << 8)
+            length = (payload[pos + 1] >> 4) + LZ_MIN_MATCH
+            pos += 2
+            if length == 18:
+                length += payload[pos]
+                pos += 1
+            for _ in range(length):
+                out.append(out[-dist])
+    return bytes(out)
+
+
+def estimate_cost_us(cost_model, codec, payload_size):
+    base, per_byte = cost_model[CODEC_NAMES[codec]]
+    return base + per_byte * payload_size
+
+
+def load_cost_model(calibration_path):
+    """Start from the defaults and fold in per-codec timings from /api/perf"""
+    model = dict(DEFAULT_COST_MODEL)
+    if not calibration_path:
+        return model
+
+    perf = json.loads(Path(calibration_path).read_text(encoding="utf-8"))
+    for name, stats in perf.get("codecs", {}).items():
+        if name not in model or not stats.get("frames") or not stats.get("bytes"):
+            continue
+        base = model[name][0]
+        average_us = stats["totalUs"] / stats["frames"]
+        if average_us < base:
+            # Faster than the fixed cost alone: totals from firmware that
+            # wrapped them, or from another codec
+            print(f"⚠️  Ignoring {name} calibration: {average_us:.1f} us per frame is below the "
+                  f"{base:.1f} us base cost")
+            continue
+        per_byte = (stats["totalUs"] - base * stats["frames"]) / stats["bytes"]
+        model[name] = (base, per_byte)
+        print(f"📏 Calibrated {name}: {base:.1f} us + {per_byte:.4f} us/byte")
+    return model
+
+
+def encode_frame(frame, base, cost_model, budget_us, allowed):
+    """Pick the smallest allowed encoding that decodes within budget_us"""
+    candidates = []
+    for codec, encoder in ENCODERS:
+        if codec not in allowed:
+            continue
+        payload = encoder(frame, base)
+        if payload is None:
+            continue
+        if codec == CODEC_LZ and decode_lz(payload) != frame:
+            raise RuntimeError("LZ self-check failed")
+        cost = estimate_cost_us(cost_model, codec, len(payload))
+        candidates.append((len(payload), cost, codec, payload))
+
+    in_budget = [c for c in candidates if c[1] <= budget_us]
+    if in_budget:
+        size, cost, codec, payload = min(in_budget, key=lambda c: (c[0], c[1]))
+    else:
+        # Nothing fits - take the cheapest to decode rather than the smallest
+        size, cost, codec, payload = min(candidates, key=lambda c: (c[1], c[0]))
+    return codec, payload, cost
+
+
+def apply_frame(codec, payload, frame):
+    """Reference player step, used to verify every clip's playback"""
+    if codec == CODEC_HOLD:
+        return frame
+    if codec == CODEC_RAW:
+        return payload
+    if codec == CODEC_LZ:
+        return decode_lz(payload)
+
+    out = bytearray(frame)
+    pos = 0
+    i = 0
+    while i + 2 <= len(payload):
+        pos += payload[i]
+        count = payload[i + 1]
+        for b in payload[i + 2:i + 2 + count]:
+            out[pos] ^= b
+            pos += 1
+        i += 2 + count
+    return bytes(out)
+
+
+def detect_pingpong(sequence, loop):
+    """Return the forward half P if pingpong playback of P shows sequence
+
+    A looping clip repeats P + reversed(P) without its ends, the first frame
+    comes round again by itself. A clip that plays once ends back on its
+    first frame, so only the turning frame isn't repeated.
+    """
+    length = len(sequence)
+    if length < 3 or length % 2 != (0 if loop else 1):
+        return None
+    half = (length + 2) // 2 if loop else (length + 1) // 2
+    if loop and half < 3:
+        return None
+    for k in range(1, length - half + 1):
+        if sequence[half - 1 + k] != sequence[half - 1 - k]:
+            return None
+    return sequence[:half]
+
+
+# ---------------------------------------------------------------------------
+# Pack builder
+# ---------------------------------------------------------------------------
+
+class StoredFrame:
+    """One stored frame: its image, the image its delta applies to and codec constraints"""
+
+    def __init__(self, image, base):
+        self.image = image
+        self.base = base
+        self.force_key = base is None
+        self.reversible = False
+
+
+class PackBuilder:
+    """Lays clips out as segments over shared stored frames
+
+    Frames are stored once and referenced by (first, count, reverse) segments,
+    so repeated runs and mirrored runs (blinks, look left/right) cost a 6 byte
+    segment instead of their frames. Which frames have to be keyframes or
+    stay XOR/hold (so they can be undone when played backwards) falls out of
+    simulating each clip exactly the way AnimPlayer plays it.
+    """
+
+    def __init__(self):
+        self.images = []
+        self.image_ids = {}
+        self.frames = []
+        self.segments = []  # [first frame, frame count, reverse]
+        self.clips = []
+
+    def image_id(self, page):
+        if page not in self.image_ids:
+            self.image_ids[page] = len(self.images)
+            self.images.append(page)
+        return self.image_ids[page]
+
+    def can_step(self, index, backward, current, mark=False):
+        """Can the player show frame index next when `current` is on screen?
+
+        Mirrors AnimPlayer: forward steps apply the frame, backward steps
+        either decode a keyframe or undo the following XOR/hold frame.
+        """
+        frame = self.frames[index]
+        if frame.force_key:
+            return True
+        if current is None:
+            return False
+        if not backward:
+            return frame.base == current
+        if index + 1 >= len(self.frames):
+            return False
+        following = self.frames[index + 1]
+        ok = (not following.force_key and following.image == current
+              and following.base == frame.image)
+        if ok and mark:
+            following.reversible = True
+        return ok
+
+    def find_reuse(self, sequence, i, current):
+        """Longest already stored run, forwards or backwards, that shows sequence[i:]"""
+        best = None
+        stored = len(self.frames)
+        for p in range(stored):
+            if self.frames[p].image != sequence[i]:
+                continue
+            for step in (1, -1):
+                length = 0
+                shown = current
+                while i + length < len(sequence) and 0 <= p + step * length < stored:
+                    index = p + step * length
+                    if self.frames[index].image != sequence[i + length]:
+                        break
+                    if not self.can_step(index, step < 0, shown):
+                        break
+                    shown = sequence[i + length]
+                    length += 1
+                if length >= MIN_REUSE_FRAMES and (best is None or length > best[1]):
+                    best = (p if step > 0 else p - length + 1, length, step < 0)
+        return best
+
+    def add_sequence(self, sequence, current):
+        """Append segments showing sequence, returns the image left on screen"""
+        floor = len(self.segments)
+        i = 0
+        while i < len(sequence):
+            reuse = self.find_reuse(sequence, i, current)
+            if reuse:
+                self.segments.append(list(reuse))
+                i += reuse[1]
+                current = sequence[i - 1]
+                continue
+
+            self.frames.append(StoredFrame(sequence[i], current))
+            index = len(self.frames) - 1
+            last = self.segments[-1] if len(self.segments) > floor else None
+            if last and not last[2] and last[0] + last[1] == index:
+                last[1] += 1
+            else:
+                self.segments.append([index, 1, False])
+            current = sequence[i]
+            i += 1
+        return current
+
+    def add_clip(self, name, pages, delay, loop, mode, loop_from, hot=False, interpolate="none"):
+        sequence = [self.image_id(page) for page in pages]
+        expected = self.source_order(sequence, loop_from, "forward" if mode == "auto" else mode, loop)
+        if mode == "auto":
+            mode = "forward"
+            half = detect_pingpong(sequence[loop_from:], loop)
+            if half is not None:
+                sequence = sequence[:loop_from] + half
+                mode = "pingpong"
+
+        first_segment = len(self.segments)
+        shown = self.add_sequence(sequence[:loop_from], None)
+        loop_segment = len(self.segments) - first_segment
+        self.add_sequence(sequence[loop_from:], shown)
+
+        self.clips.append({
+            "name": name,
+            "first_segment": first_segment,
+            "segment_count": len(self.segments) - first_segment,
+            "loop_segment": loop_segment,
+            "delay": delay,
+            "loop": loop,
+            "mode": mode,
+            "length": len(pages),
+            "expected": expected,
+            "hot": hot,
+            "interpolate": interpolate,
+        })
+        return mode
+
+    @staticmethod
+    def source_order(sequence, loop_from, mode, loop):
+        """Images the clip should show in mode, two body cycles for looping clips like playback()"""
+        body = sequence[loop_from:]
+        if mode == "reverse":
+            cycle = body[::-1]
+        elif mode == "pingpong":
+            cycle = body + (body[-2:0:-1] if loop else body[-2::-1])
+        else:
+            cycle = body
+        return sequence[:loop_from] + cycle * (2 if loop else 1)
+
+    def expand(self, segments):
+        """(frame index, backward) for every frame of the segments, in order"""
+        shown = []
+        for first, count, reverse in segments:
+            for k in range(count):
+                shown.append((first + count - 1 - k, True) if reverse else (first + k, False))
+        return shown
+
+    def playback(self, clip):
+        """Frames in the order AnimPlayer shows them, two body cycles for looping clips"""
+        segments = self.segments[clip["first_segment"]:clip["first_segment"] + clip["segment_count"]]
+        intro = self.expand(segments[:clip["loop_segment"]])
+        body = self.expand(segments[clip["loop_segment"]:])
+        backwards = [(index, not backward) for index, backward in reversed(body)]
+
+        if clip["mode"] == "reverse":
+            cycle = backwards
+        elif clip["mode"] == "pingpong":
+            cycle = body + (backwards[1:-1] if clip["loop"] else backwards[1:])
+        else:
+            cycle = body
+        return intro + cycle * (2 if clip["loop"] else 1)
+
+    def resolve_keyframes(self):
+        """Force keyframes wherever the player could not otherwise get to a frame"""
+        while True:
+            for frame in self.frames:
+                frame.reversible = False
+            changed = False
+            for clip in self.clips:
+                current = None
+                for index, backward in self.playback(clip):
+                    if not self.can_step(index, backward, current, mark=True):
+                        self.frames[index].force_key = True
+                        changed = True
+                    current = self.frames[index].image
+            if not changed:
+                return
+
+    def records_used(self, clip, encoded):
+        """Frame records the player reads for clip, in the order it reads them"""
+        used = []
+        for index, backward in self.playback(clip):
+            if backward and not encoded[index][1] & FRAME_FLAG_KEY:
+                index += 1
+            used.append(index)
+        return used
+
+    def layout_order(self, encoded):
+        """Hot clips first, then the rest, each in the order playback reads them"""
+        clips = [c for c in self.clips if c["hot"]] + [c for c in self.clips if not c["hot"]]
+        order = []
+        placed = set()
+        for clip in clips:
+            for index in self.records_used(clip, encoded):
+                if index not in placed:
+                    placed.add(index)
+                    order.append(index)
+        order += [index for index in range(len(encoded)) if index not in placed]
+        return order
+
+    def verify(self, encoded):
+        """Decode every clip like the firmware does and compare against the source"""
+        for clip in self.clips:
+            played = [self.frames[index].image for index, _ in self.playback(clip)]
+            if played != clip["expected"]:
+                raise RuntimeError(f"{clip['name']}: plays {len(played)} frames, not the "
+                                   f"{len(clip['expected'])} of its source")
+            shown = None
+            for index, backward in self.playback(clip):
+                codec, flags, payload = encoded[index]
+                if not backward or flags & FRAME_FLAG_KEY:
+                    shown = apply_frame(codec, payload, shown)
+                else:
+                    next_codec, next_flags, next_payload = encoded[index + 1]
+                    if next_flags & FRAME_FLAG_KEY:
+                        raise RuntimeError(f"{clip['name']}: cannot step back over keyframe {index + 1}")
+                    shown = apply_frame(next_codec, next_payload, shown)
+                if shown != self.images[self.frames[index].image]:
+                    raise RuntimeError(f"{clip['name']}: frame {index} decodes wrong")
+
+
+def align(value, boundary=4):
+    return (value + boundary - 1) & ~(boundary - 1)
+
+
+def cache_lines(offset, size):
+    """Number of flash cache lines a record at offset touches"""
+    if size == 0:
+        return 0
+    return (offset + size - 1) // CACHE_LINE - offset // CACHE_LINE + 1
+
+
+def build_pack(manifest_path, budget_us=DEFAULT_BUDGET_US, calibration=None, verbose=True):
+    """Compile every clip in the manifest into a pack blob"""
+    manifest_path = Path(manifest_path)
+    manifest = json.loads(manifest_path.read_text(encoding="utf-8"))
+    cost_model = load_cost_model(calibration)
+
+    builder = PackBuilder()
+    for clip in manifest["clips"]:
+        bitmaps, delay = parse_clip_header(manifest_path.parent / clip["source"])
+        if not bitmaps:
+            raise RuntimeError(f"No frames found in {clip['source']}")
+        mode = clip.get("mode", "auto")
+        if mode != "auto" and mode not in PLAY_MODES:
+            raise RuntimeError(f"{clip['name']}: unknown mode {mode}")
+        interpolate = clip.get("interpolate", "none")
+        if interpolate not in CLIP_FLAGS_INTERPOLATE:
+            raise RuntimeError(f"{clip['name']}: unknown interpolate {interpolate}")
+        loop_from = clip.get("loopFrom", 0)
+        if not 0 <= loop_from < len(bitmaps):
+            raise RuntimeError(f"{clip['name']}: loopFrom out of range")
+
+        pages = [to_page_format(bitmap) for bitmap in bitmaps]
+        mode = builder.add_clip(clip["name"], pages, clip.get("frameDelay", delay),
+                                clip.get("loop", True), mode, loop_from, clip.get("hot", False), interpolate)
+        if verbose:
+            print(f"🎞️  {clip['name']}: {len(bitmaps)} frames @ {delay} ms ({mode})")
+
+    builder.resolve_keyframes()
+
+    frames = []  # (codec, flags, payload)
+    stats = {name: [0, 0] for name in CODEC_NAMES.values()}
+    worst_cost = 0.0
+    for frame in builder.frames:
+        if frame.force_key:
+            allowed = (CODEC_RAW, CODEC_LZ)
+        elif frame.reversible:
+            allowed = (CODEC_HOLD, CODEC_XOR)
+        else:
+            allowed = (CODEC_HOLD, CODEC_XOR, CODEC_LZ, CODEC_RAW)
+        base = builder.images[frame.base] if frame.base is not None else None
+        codec, payload, cost = encode_frame(builder.images[frame.image], base, cost_model, budget_us, allowed)
+        flags = FRAME_FLAG_KEY if codec in (CODEC_RAW, CODEC_LZ) else 0
+        frames.append((codec, flags, payload))
+        stats[CODEC_NAMES[codec]][0] += 1
+        stats[CODEC_NAMES[codec]][1] += len(payload)
+        worst_cost = max(worst_cost, cost)
+
+    builder.verify(frames)
+
+    header_size = struct.calcsize(HEADER_FORMAT)
+    clip_table_offset = header_size
+    segment_table_offset = align(clip_table_offset + len(builder.clips) * struct.calcsize(CLIP_FORMAT))
+    frame_index_offset = align(segment_table_offset + len(builder.segments) * struct.calcsize(SEGMENT_FORMAT))
+    data_offset = align(frame_index_offset + len(frames) * 4)
+
+    # Records go in playback order so a clip streams through consecutive
+    # cache lines, a record is only bumped to a fresh line when it would
+    # otherwise straddle one more line than its size needs
+    body = bytearray()
+    offsets = [0] * len(frames)
+    for index in builder.layout_order(frames):
+        codec, flags, payload = frames[index]
+        record = struct.pack(FRAME_HEADER_FORMAT, codec, flags, len(payload)) + payload
+        offset = data_offset + len(body)
+        needed = (len(record) + CACHE_LINE - 1) // CACHE_LINE
+        if cache_lines(offset, len(record)) > needed:
+            offset = align(offset, CACHE_LINE)
+        body += bytes(offset - data_offset - len(body))
+        offsets[index] = offset
+        body += record
+        body += bytes(align(len(body)) - len(body))
+
+    total_size = data_offset + len(body)
+    blob = bytearray(struct.pack(HEADER_FORMAT, PACK_MAGIC, PACK_VERSION, len(builder.clips), len(frames),
+                                 len(builder.segments), budget_us, 0, clip_table_offset,
+                                 segment_table_offset, frame_index_offset, total_size))
+    for clip in builder.clips:
+        flags = (CLIP_FLAG_LOOP if clip["loop"] else 0) | CLIP_FLAGS_INTERPOLATE[clip["interpolate"]]
+        blob += struct.pack(CLIP_FORMAT, clip["name"].encode("ascii")[:15], clip["first_segment"],
+                            clip["segment_count"], clip["delay"], flags, PLAY_MODES[clip["mode"]],
+                            clip["loop_segment"], 0)
+    blob += bytes(segment_table_offset - len(blob))
+    for first, count, reverse in builder.segments:
+        blob += struct.pack(SEGMENT_FORMAT, first, count, SEGMENT_FLAG_REVERSE if reverse else 0, 0)
+    blob += bytes(frame_index_offset - len(blob))
+    for offset in offsets:
+        blob += struct.pack("<I", offset)
+    blob += bytes(data_offset - len(blob))
+    blob += body
+
+    if verbose:
+        shown = sum(clip["length"] for clip in builder.clips)
+        raw_size = shown * FRAME_BYTES
+        reversed_segments = sum(1 for segment in builder.segments if segment[2])
+        print(f"📦 Pack: {len(builder.clips)} clips, {shown} frames shown from {len(frames)} stored "
+              f"in {len(builder.segments)} segments ({reversed_segments} reversed), {total_size} bytes "
+              f"({100.0 * total_size / raw_size:.1f}% of {raw_size} raw)")
+        for name, (count, size) in stats.items():
+            if count:
+                print(f"   {name:>4}: {count:3d} frames, {size:6d} bytes")
+        print(f"⏱️  Worst estimated decode: {worst_cost:.1f} us (budget {budget_us} us)")
+        for clip in builder.clips:
+            lines = set()
+            for index in builder.records_used(clip, frames):
+                size = struct.calcsize(FRAME_HEADER_FORMAT) + len(frames[index][2])
+                first_line = offsets[index] // CACHE_LINE
+                lines.update(range(first_line, first_line + cache_lines(offsets[index], size)))
+            print(f"   {clip['name']:>10}: {len(lines)} cache lines per loop"
+                  f" ({lines and max(lines) - min(lines) + 1} line span){' [hot]' if clip['hot'] else ''}")
+
+    return bytes(blob)
+
+
+def write_header(blob, path, symbol="anim_pack_data"):
+    """Emit the pack as a PROGMEM array, returns False if the file was already current"""
+    lines = [
+        "// Generated by tools/animpack.py - do not edit",
+        "#ifndef ANIM_PACK_DATA_H",
+        "#define ANIM_PACK_DATA_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        f"#define ANIM_PACK_DATA_SIZE {len(blob)}",
+        "",
+        "// Cache line aligned so the in-pack record alignment holds in flash",
+        f"const uint8_t {symbol}[] PROGMEM __attribute__((aligned({CACHE_LINE}))) = {{",
+    ]
+    for i in range(0, len(blob), 16):
+        lines.append("  " + ", ".join(f"0x{b:02x}" for b in blob[i:i + 16]) + ",")
+    lines += ["};", "", "#endif", ""]
+
+    text = "\n".join(lines)
+    path = Path(path)
+    if path.exists() and path.read_text(encoding="utf-8") == text:
+        return False
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(text, encoding="utf-8")
+    return True
+
+
+def frame_records(blob):
+    """(offset, size) of every frame record in a pack, by frame index"""
+    header = struct.unpack_from(HEADER_FORMAT, blob)
+    frame_count, index_offset = header[3], header[9]
+    records = []
+    for i in range(frame_count):
+        (offset,) = struct.unpack_from("<I", blob, index_offset + 4 * i)
+        _, _, payload_size = struct.unpack_from(FRAME_HEADER_FORMAT, blob, offset)
+        records.append((offset, struct.calcsize(FRAME_HEADER_FORMAT) + payload_size))
+    return records
+
+
+def build_patch(blob, device_hashes):
+    """Patch stream that rebuilds `blob` on a device holding records with these hashes"""
+    have = {}
+    for index, value in enumerate(device_hashes):
+        have.setdefault(int(value, 16), index)
+
+    patch = bytearray()
+    cursor = 0
+
+    def literal(end):
+        if end > cursor:
+            patch.extend(struct.pack("<BI", PATCH_LITERAL, end - cursor))
+            patch.extend(blob[cursor:end])
+
+    for offset, size in sorted(frame_records(blob)):
+        index = have.get(zlib.crc32(blob[offset:offset + size]))
+        if index is None:
+            continue
+        literal(offset)
+        patch.extend(struct.pack("<BH", PATCH_COPY, index))
+        cursor = offset + size
+    literal(len(blob))
+    return bytes(patch)
+
+
+def post_json(url, body):
+    request = urllib.request.Request(url, data=body, method="POST",
+                                     headers={"Content-Type": "application/octet-stream"})
+    try:
+        with urllib.request.urlopen(request, timeout=60) as response:
+            return json.loads(response.read())
+    except urllib.error.HTTPError as e:
+        return json.loads(e.read() or b"{}")
+
+
+def get_json(url):
+    with urllib.request.urlopen(url, timeout=10) as response:
+        return json.loads(response.read())
+
+
+def upload_chunked(blob, host, retries=5):
+    """Send the pack in pieces the device asks for, continuing after dropped connections"""
+    crc = zlib.crc32(blob)
+    status = get_json(f"http://{host}/api/assets/upload")
+    same = status.get("size") == len(blob) and status.get("crc32") == f"{crc:08x}"
+    offset = status["nextOffset"] if same else 0
+    chunk = status["maxChunk"]
+    if offset:
+        print(f"📦 Continuing upload at {offset} of {len(blob)} bytes")
+
+    failures = 0
+    while True:
+        url = f"http://{host}/api/assets/upload?offset={offset}&size={len(blob)}&crc32={crc:08x}"
+        try:
+            result = post_json(url, blob[offset:offset + chunk])
+        except (urllib.error.URLError, OSError) as e:
+            failures += 1
+            if failures > retries:
+                raise
+            print(f"⚠️ {e}, asking the device where to continue")
+            result = get_json(f"http://{host}/api/assets/upload")
+            if not result.get("active"):
+                result["nextOffset"] = 0
+        else:
+            if result.get("complete") or "nextOffset" not in result:
+                return result
+            if not result.get("success"):
+                failures += 1
+                if failures > retries:
+                    return result
+        offset = result["nextOffset"]
+        chunk = result["maxChunk"]
+        print(f"   {offset * 100 // len(blob)}% ({chunk} byte chunks)")
+
+
+def upload_pack(blob, host):
+    """Send the pack to a running device, which switches to it once verified
+    Frames the device already has are copied on the device instead of sent,
+    anything that goes wrong with that falls back to a chunked full upload."""
+    crc = zlib.crc32(blob)
+    result = None
+    try:
+        with urllib.request.urlopen(f"http://{host}/api/assets/hashes", timeout=10) as response:
+            device_hashes = json.loads(response.read())["frames"]
+        patch = build_patch(blob, device_hashes)
+        if len(patch) < len(blob):
+            print(f"📦 Sending {len(patch)} of {len(blob)} bytes, the device has the other frames")
+            result = post_json(f"http://{host}/api/assets/sync?size={len(blob)}&crc32={crc:08x}", patch)
+            if not result.get("success"):
+                print(f"⚠️ Sync failed ({result.get('error', 'unknown error')}), sending the whole pack")
+                result = None
+    except (urllib.error.URLError, KeyError, ValueError) as e:
+        print(f"⚠️ No frame hashes from {host} ({e}), sending the whole pack")
+
+    if result is None:
+        try:
+            result = upload_chunked(blob, host)
+        except (urllib.error.URLError, OSError) as e:
+            result = {"error": str(e)}
+    if not result.get("success"):
+        print(f"❌ Upload failed: {result.get('error', 'unknown error')}")
+        return False
+    print(f"✅ Uploaded to {host}: slot {result['slot']}, {result['clips']} clips")
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile Tabbie animation clips into a pack")
+    parser.add_argument("manifest", help="clip manifest (assets/clips.json)")
+    parser.add_argument("--out-bin", help="write the raw pack blob here")
+    parser.add_argument("--out-header", help="write the pack as a C header here")
+    parser.add_argument("--budget-us", type=int, default=DEFAULT_BUDGET_US,
+                        help="worst-case decode time allowed per frame")
+    parser.add_argument("--calibration", help="JSON saved from /api/perf to refine the cost model")
+    parser.add_argument("--upload", metavar="HOST", help="send the pack to a device (tabbie.local or its IP)")
+    args = parser.parse_args()
+
+    blob = build_pack(args.manifest, args.budget_us, args.calibration)
+    if args.out_bin:
+        Path(args.out_bin).write_bytes(blob)
+        print(f"✅ Wrote {args.out_bin}")
+    if args.out_header:
+        write_header(blob, args.out_header)
+        print(f"✅ Wrote {args.out_header}")
+    if args.upload and not upload_pack(blob, args.upload):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
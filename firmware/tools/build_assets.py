@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""
+PlatformIO pre-build script to compile assets/ into the animation pack
+The pack is written to $BUILD_DIR/assets.bin and flashed to the `assets`
+partition (partitions.csv) by the `upload_assets` target and after every
+firmware upload, so art changes don't need a firmware rebuild.
+
+With `custom_embed_assets = yes` the pack is also compiled into the app
+image (include/generated/anim_pack_data.h) as a fallback for boards whose
+assets partition hasn't been flashed. Generated files are only rewritten
+when their contents change, so unchanged art doesn't trigger a recompile.
+"""
+
+import csv
+import sys
+from pathlib import Path
+
+Import("env")
+
+project_dir = Path(env.get("PROJECT_DIR"))
+sys.path.insert(0, str(project_dir / "tools"))
+
+import animpack  # noqa: E402
+
+PARTITION_LABEL = "assets"
+# A/B slots the partition is split into - must match ASSET_SLOT_COUNT in src/asset_store.h
+SLOT_COUNT = 2
+
+
+def pack_path():
+    return Path(env.subst("$BUILD_DIR")) / "assets.bin"
+
+
+def partition_table():
+    name = env.GetProjectOption("board_build.partitions", "")
+    return project_dir / name if name else None
+
+
+def partition_offset(label):
+    """Offset and size of a partition in the project's partitions.csv"""
+    table = partition_table()
+    if not table or not table.exists():
+        return None, None
+    with open(table, newline="", encoding="utf-8") as f:
+        for row in csv.reader(f):
+            row = [cell.strip() for cell in row]
+            if not row or row[0].startswith("#") or len(row) < 5:
+                continue
+            if row[0] == label:
+                return int(row[3], 0), int(row[4], 0)
+    return None, None
+
+
+def build_assets():
+    """Run the pack compiler over assets/clips.json"""
+    manifest = project_dir / "assets" / "clips.json"
+    budget = int(env.GetProjectOption("custom_decode_budget_us", str(animpack.DEFAULT_BUDGET_US)))
+    embed = env.GetProjectOption("custom_embed_assets", "no").lower() in ("yes", "true", "1")
+
+    print(f"🎨 Compiling animation pack (decode budget {budget} us)...")
+    blob = animpack.build_pack(manifest, budget)
+
+    _, partition_size = partition_offset(PARTITION_LABEL)
+    if partition_size is not None and len(blob) > partition_size // SLOT_COUNT:
+        sys.stderr.write(f"❌ Animation pack is {len(blob)} bytes, an assets slot holds {partition_size // SLOT_COUNT}\n")
+        env.Exit(1)
+
+    output = pack_path()
+    output.parent.mkdir(parents=True, exist_ok=True)
+    if not output.exists() or output.read_bytes() != blob:
+        output.write_bytes(blob)
+        print(f"✅ Animation pack written to {output}")
+    else:
+        print("✅ Animation pack unchanged")
+
+    if embed:
+        animpack.write_header(blob, project_dir / "include" / "generated" / "anim_pack_data.h")
+        env.Append(CPPDEFINES=["TABBIE_EMBED_ASSETS"])
+
+
+def upload_assets(*args, **kwargs):
+    """Write the pack to the assets partition with esptool
+    Both slots get the pack, so it is used whichever slot the device last
+    switched to after an upload over HTTP."""
+    offset, size = partition_offset(PARTITION_LABEL)
+    if offset is None:
+        sys.stderr.write(f"❌ No '{PARTITION_LABEL}' partition in {partition_table()}\n")
+        env.Exit(1)
+
+    env.AutodetectUploadPort()
+    command = [
+        '"$PYTHONEXE"', '"$UPLOADER"',
+        "--chip", "esp32",
+        "--port", '"$UPLOAD_PORT"',
+        "--baud", "$UPLOAD_SPEED",
+        "write_flash",
+    ]
+    for slot in range(SLOT_COUNT):
+        command += [hex(offset + slot * size // SLOT_COUNT), f'"{pack_path()}"']
+    command = " ".join(command)
+    return env.Execute(env.VerboseAction(command, f"📤 Uploading animation pack to 0x{offset:x}"))
+
+
+build_assets()
+
+if env.get("PIOPLATFORM") != "native":
+    env.AddCustomTarget(
+        name="upload_assets",
+        dependencies=None,
+        actions=[upload_assets],
+        title="Upload Assets",
+        description="Flash the animation pack to the assets partition",
+    )
+    env.AddPostAction("upload", upload_assets)
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""
+PlatformIO pre-build script to pre-render the firmware's fonts
+Decodes the U8g2 fonts listed in tools/glyphatlas.py from the installed U8g2
+library into include/generated/glyph_atlas_data.h (see src/text.h). The
+header is only rewritten when its contents change, so it doesn't trigger a
+recompile on every build.
+"""
+
+import sys
+from pathlib import Path
+
+Import("env")
+
+project_dir = Path(env.get("PROJECT_DIR"))
+sys.path.insert(0, str(project_dir / "tools"))
+
+import glyphatlas  # noqa: E402
+
+
+def font_source():
+    """u8g2_fonts.c of the U8g2 library lib_deps installed for this environment"""
+    libdeps = Path(env.subst("$PROJECT_LIBDEPS_DIR")) / env.subst("$PIOENV")
+    for path in sorted(libdeps.glob("U8g2*/src/clib/u8g2_fonts.c")):
+        return path
+    return None
+
+
+def build_glyphs():
+    source = font_source()
+    if source is None:
+        sys.stderr.write("❌ U8g2 not found in lib_deps, can't build the glyph atlas\n")
+        env.Exit(1)
+
+    print("🔤 Pre-rendering fonts...")
+    try:
+        atlases = glyphatlas.build_atlases(source)
+    except ValueError as error:
+        sys.stderr.write(f"❌ Glyph atlas: {error}\n")
+        env.Exit(1)
+    if glyphatlas.write_header(atlases, project_dir / "include" / "generated" / "glyph_atlas_data.h"):
+        print("✅ Glyph atlas written")
+    else:
+        print("✅ Glyph atlas unchanged")
+
+
+# The native build only has the pack reader and player, no text
+if env.get("PIOPLATFORM") != "native":
+    build_glyphs()
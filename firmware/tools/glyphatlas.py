@@ -0,0 +1,244 @@
+#!/usr/bin/env python3
+"""
+Tabbie glyph atlas generator
+
+Decodes the U8g2 fonts the firmware draws text with from the library's
+u8g2_fonts.c and writes their printable ASCII glyphs pre-rendered in SH1106
+page format (see src/text.h for the matching reader). Every glyph is a cell
+as wide as its advance and as tall as the font's tallest glyph, so drawing
+a string is copying columns instead of decoding U8g2's run-length glyphs
+on every drawStr().
+"""
+
+import argparse
+import re
+import sys
+from pathlib import Path
+
+# U8g2 font and the name of its atlas - must match the fonts declared in src/text.h
+FONTS = [
+    ("u8g2_font_6x10_tf", "GLYPH_FONT_6X10"),
+    ("u8g2_font_10x20_tf", "GLYPH_FONT_10X20"),
+]
+
+FIRST_CHAR = 32
+LAST_CHAR = 126
+
+FONT_HEADER_SIZE = 23
+# Cells are gathered into one 32 bit column word on the device
+MAX_CELL_HEIGHT = 24
+
+FONT_ARRAY = re.compile(r"const\s+uint8_t\s+(\w+)\s*\[\s*(\d+)\s*\][^=]*=\s*((?:\"(?:[^\"\\]|\\.)*\"\s*)+);")
+C_STRING = re.compile(r"\"((?:[^\"\\]|\\.)*)\"")
+C_ESCAPE = re.compile(r"\\([0-7]{1,3}|x[0-9a-fA-F]+|.)")
+SIMPLE_ESCAPES = {"n": 10, "t": 9, "r": 13, "a": 7, "b": 8, "f": 12, "v": 11}
+
+
+def unescape_c(text):
+    """Bytes of a C string literal body"""
+    out = bytearray()
+    pos = 0
+    for match in C_ESCAPE.finditer(text):
+        out += text[pos:match.start()].encode("latin-1")
+        escape = match.group(1)
+        if escape[0] in "01234567":
+            out.append(int(escape, 8) & 0xFF)
+        elif escape[0] == "x":
+            out.append(int(escape[1:], 16) & 0xFF)
+        else:
+            out.append(SIMPLE_ESCAPES.get(escape, ord(escape)))
+        pos = match.end()
+    out += text[pos:].encode("latin-1")
+    return bytes(out)
+
+
+def load_fonts(source, names):
+    """Font data by name from u8g2_fonts.c"""
+    text = Path(source).read_text(encoding="latin-1")
+    fonts = {}
+    for match in FONT_ARRAY.finditer(text):
+        name, size, literals = match.group(1), int(match.group(2)), match.group(3)
+        if name not in names:
+            continue
+        data = b"".join(unescape_c(body) for body in C_STRING.findall(literals))
+        fonts[name] = data[:size]
+    missing = [name for name in names if name not in fonts]
+    if missing:
+        raise ValueError(f"{', '.join(missing)} not found in {source}")
+    return fonts
+
+
+class BitReader:
+    """U8g2 glyph bit stream, LSB first"""
+
+    def __init__(self, data, offset):
+        self.data = data
+        self.offset = offset
+        self.bit = 0
+
+    def unsigned(self, count):
+        value = 0
+        for i in range(count):
+            byte = self.data[self.offset]
+            value |= ((byte >> self.bit) & 1) << i
+            self.bit += 1
+            if self.bit == 8:
+                self.bit = 0
+                self.offset += 1
+        return value
+
+    def signed(self, count):
+        return self.unsigned(count) - (1 << (count - 1))
+
+
+def decode_font(data):
+    """Glyphs by character: (width, height, x, y, advance, rows of 0/1)
+    y is the glyph's bottom above the baseline, as in U8g2."""
+    bits_0, bits_1 = data[2], data[3]
+    bits_w, bits_h, bits_x, bits_y, bits_dx = data[4:9]
+
+    glyphs = {}
+    pos = FONT_HEADER_SIZE
+    while pos + 1 < len(data) and data[pos + 1] != 0:
+        code, size = data[pos], data[pos + 1]
+        reader = BitReader(data, pos + 2)
+        width = reader.unsigned(bits_w)
+        height = reader.unsigned(bits_h)
+        x = reader.signed(bits_x)
+        y = reader.signed(bits_y)
+        advance = reader.signed(bits_dx)
+
+        pixels = []
+        if width > 0:
+            total = width * height
+            while len(pixels) < total:
+                zeros = reader.unsigned(bits_0)
+                ones = reader.unsigned(bits_1)
+                while True:
+                    pixels += [0] * zeros + [1] * ones
+                    if reader.unsigned(1) == 0:
+                        break
+            pixels = pixels[:total]
+        rows = [pixels[r * width:(r + 1) * width] for r in range(height)] if width else []
+        glyphs[code] = (width, height, x, y, advance, rows)
+        pos += size
+    return glyphs
+
+
+def build_atlas(glyphs):
+    """Cell height, ascent, and per character (advance, page-format bytes)"""
+    chars = range(FIRST_CHAR, LAST_CHAR + 1)
+    present = [glyphs[c] for c in chars if c in glyphs and glyphs[c][0]]
+    ascent = max(h + y for _, h, _, y, _, _ in present)
+    descent = max(-y for _, _, _, y, _, _ in present)
+    height = ascent + max(descent, 0)
+    if height > MAX_CELL_HEIGHT:
+        raise ValueError(f"glyphs are {height} px tall, at most {MAX_CELL_HEIGHT} fit")
+    pages = (height + 7) // 8
+
+    cells = []
+    for c in chars:
+        if c not in glyphs:
+            # Missing characters draw as a blank the width of a space
+            advance = glyphs.get(ord(" "), (0, 0, 0, 0, 1, []))[4]
+            cells.append((advance, bytes(pages * advance)))
+            continue
+        width, gh, gx, gy, advance, rows = glyphs[c]
+        cell = bytearray(pages * advance)
+        top = ascent - (gh + gy)
+        for r, row in enumerate(rows):
+            for col, lit in enumerate(row):
+                cx, cy = gx + col, top + r
+                # Overhangs past the advance are dropped, the fixed fonts have none
+                if lit and 0 <= cx < advance and 0 <= cy < height:
+                    cell[(cy // 8) * advance + cx] |= 1 << (cy % 8)
+        cells.append((advance, bytes(cell)))
+    return height, ascent, cells
+
+
+def write_header(atlases, path):
+    """Emit the atlases as PROGMEM arrays, returns False if the file was already current"""
+    lines = [
+        "// Generated by tools/glyphatlas.py - do not edit",
+        "#ifndef GLYPH_ATLAS_DATA_H",
+        "#define GLYPH_ATLAS_DATA_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        '#include "text.h"',
+        "",
+    ]
+    for symbol, (height, ascent, cells) in atlases:
+        prefix = symbol.lower()
+        offsets = []
+        blob = bytearray()
+        for _, cell in cells:
+            offsets.append(len(blob))
+            blob += cell
+        lines.append(f"static const uint8_t {prefix}_widths[] PROGMEM = {{")
+        for i in range(0, len(cells), 16):
+            lines.append("  " + ", ".join(str(advance) for advance, _ in cells[i:i + 16]) + ",")
+        lines += ["};", f"static const uint16_t {prefix}_offsets[] PROGMEM = {{"]
+        for i in range(0, len(offsets), 16):
+            lines.append("  " + ", ".join(str(o) for o in offsets[i:i + 16]) + ",")
+        lines += ["};", f"static const uint8_t {prefix}_bits[] PROGMEM = {{"]
+        for i in range(0, len(blob), 16):
+            lines.append("  " + ", ".join(f"0x{b:02x}" for b in blob[i:i + 16]) + ",")
+        lines += [
+            "};",
+            f"const GlyphFont {symbol} = {{{FIRST_CHAR}, {len(cells)}, {height}, {ascent}, "
+            f"{prefix}_widths, {prefix}_offsets, {prefix}_bits}};",
+            "",
+        ]
+    lines += ["#endif", ""]
+
+    text = "\n".join(lines)
+    path = Path(path)
+    if path.exists() and path.read_text(encoding="utf-8") == text:
+        return False
+    path.parent.mkdir(parents=True, exist_ok=True)
+    path.write_text(text, encoding="utf-8")
+    return True
+
+
+def build_atlases(source):
+    fonts = load_fonts(source, [name for name, _ in FONTS])
+    return [(symbol, build_atlas(decode_font(fonts[name]))) for name, symbol in FONTS]
+
+
+def preview(atlas, text):
+    """The string as rows of # and ., to check the decoding by eye"""
+    height, _, cells = atlas
+    rows = ["" for _ in range(height)]
+    for ch in text:
+        index = ord(ch) - FIRST_CHAR
+        if not 0 <= index < len(cells):
+            continue
+        advance, cell = cells[index]
+        for y in range(height):
+            rows[y] += "".join("#" if cell[(y // 8) * advance + x] >> (y % 8) & 1 else "." for x in range(advance))
+    return "\n".join(rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pre-render the firmware's U8g2 fonts in page format")
+    parser.add_argument("fonts", help="u8g2_fonts.c from the U8g2 library")
+    parser.add_argument("--out-header", help="write the atlases as a C header here")
+    parser.add_argument("--preview", metavar="TEXT", help="print TEXT in every font")
+    args = parser.parse_args()
+
+    atlases = build_atlases(args.fonts)
+    for symbol, atlas in atlases:
+        height, ascent, cells = atlas
+        size = sum(len(cell) for _, cell in cells)
+        print(f"{symbol}: {len(cells)} glyphs, {height} px tall, {size} bytes")
+        if args.preview:
+            print(preview(atlas, args.preview))
+    if args.out_header:
+        write_header(atlases, args.out_header)
+        print(f"✅ Wrote {args.out_header}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
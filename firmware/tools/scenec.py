@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""
+Tabbie scene compiler
+
+Turns a readable scene script into the "TABS" bytecode the firmware runs
+(see src/scene.h for the matching interpreter). One instruction per line,
+`#` starts a comment:
+
+    # Focus timer: eyes, a label and a bar that empties in 25 minutes
+    set $left 1500
+    loop
+      clear
+      eyes
+      text 0 62 small "Focus"
+      bar 40 54 88 9 $left 1500
+      show 1000
+      add $left -1
+    next
+
+Operands are integers or `$variables`; variables start at 0. Names:
+  fonts    small medium large
+  colors   clear set xor (or 0 1 2)
+  sprites  anger_mark brow_left brow_right
+  blends   mask or and xor
+  face     spacing eye_y width height open_left open_right tilt look_x look_y pupil happy
+  eases    linear in out inout step
+
+Instructions:
+  clear | eyes | end | next
+  show <ms>                      send the frame, continue after ms
+  color <color>
+  pixel x y | line x0 y0 x1 y1 | rect x y w h | box x y w h
+  circle x y r | disc x y r
+  text x y <font> "string"       y is the baseline
+  number x y <font> value
+  sprite <sprite> <blend> x y
+  face <param> value             sets a face parameter for eyes
+  bar x y w h value max
+  set $var value | add $var value
+  tween $var target ms [ease]    animates a variable in the background
+  loop [count]                   0 or nothing repeats forever
+"""
+
+import argparse
+import json
+import shlex
+import struct
+import sys
+import urllib.error
+import urllib.request
+from pathlib import Path
+
+SCENE_MAGIC = b"TABS"
+SCENE_VERSION = 1
+HEADER_FORMAT = "<4sBBH"
+
+# Limits - must match src/scene.h
+MAX_BYTES = 2048
+VAR_COUNT = 16
+MAX_LOOP_DEPTH = 4
+VAR_REF = 0x8000
+# Literal coordinates, sizes and radii
+COORD_MIN = -128
+COORD_MAX = 255
+
+# Op codes and operand layouts after the op byte - must match SceneOp and
+# LAYOUTS in src/scene.h/.cpp. o operand, c coordinate or size operand,
+# f font, t text, s sprite, b blend, p face parameter, v variable, e ease
+OPS = {
+    "end": (0x00, ""),
+    "show": (0x01, "o"),
+    "clear": (0x02, ""),
+    "color": (0x03, "o"),
+    "pixel": (0x04, "cc"),
+    "line": (0x05, "cccc"),
+    "rect": (0x06, "cccc"),
+    "box": (0x07, "cccc"),
+    "circle": (0x08, "ccc"),
+    "disc": (0x09, "ccc"),
+    "text": (0x0A, "ccft"),
+    "number": (0x0B, "ccfo"),
+    "sprite": (0x0C, "sbcc"),
+    "eyes": (0x0D, ""),
+    "face": (0x0E, "po"),
+    "bar": (0x0F, "ccccoo"),
+    "set": (0x10, "vo"),
+    "add": (0x11, "vo"),
+    "tween": (0x12, "veoo"),
+    "loop": (0x13, "o"),
+    "next": (0x14, ""),
+}
+
+# Must match SceneFont, FaceSprite, SpriteBlend, FaceParam and FaceEase
+FONTS = {"small": 0, "medium": 1, "large": 2}
+COLORS = {"clear": 0, "set": 1, "xor": 2}
+SPRITES = {"anger_mark": 0, "brow_left": 1, "brow_right": 2}
+BLENDS = {"mask": 0, "or": 1, "and": 2, "xor": 3}
+FACE_PARAMS = {
+    "spacing": 0, "eye_y": 1, "width": 2, "height": 3, "open_left": 4, "open_right": 5,
+    "tilt": 6, "look_x": 7, "look_y": 8, "pupil": 9, "happy": 10,
+}
+EASES = {"linear": 0, "in": 1, "out": 2, "inout": 3, "step": 4}
+
+
+class SceneError(Exception):
+    pass
+
+
+class Compiler:
+    def __init__(self):
+        self.variables = {}
+        self.code = bytearray()
+        self.depth = 0
+
+    def variable(self, token):
+        if not token.startswith("$"):
+            raise SceneError(f"expected a $variable, got {token!r}")
+        if token not in self.variables:
+            if len(self.variables) >= VAR_COUNT:
+                raise SceneError(f"more than {VAR_COUNT} variables")
+            self.variables[token] = len(self.variables)
+        return self.variables[token]
+
+    def operand(self, token):
+        if token.startswith("$"):
+            return struct.pack("<H", VAR_REF + self.variable(token))
+        try:
+            value = int(token, 0)
+        except ValueError:
+            if token in COLORS:
+                value = COLORS[token]
+            else:
+                raise SceneError(f"expected a number or $variable, got {token!r}")
+        if not -32768 <= value <= 32767 or VAR_REF <= (value & 0xFFFF) < VAR_REF + 0x100:
+            raise SceneError(f"{value} is out of range")
+        return struct.pack("<h", value)
+
+    @staticmethod
+    def name(table, token, what):
+        if token not in table:
+            raise SceneError(f"unknown {what} {token!r}, expected one of {', '.join(table)}")
+        return bytes([table[token]])
+
+    def instruction(self, words):
+        op = words[0].lower()
+        if op not in OPS:
+            raise SceneError(f"unknown instruction {op!r}")
+        code, layout = OPS[op]
+        args = words[1:]
+
+        # Optional trailing arguments
+        if op == "loop" and not args:
+            args = ["0"]
+        if op == "tween":
+            if len(args) == 3:
+                args.append("linear")
+            # Written as `tween $var target ms ease`, encoded var, ease, target, ms
+            if len(args) == 4:
+                args = [args[0], args[3], args[1], args[2]]
+
+        if len(args) != len(layout):
+            raise SceneError(f"{op} takes {len(layout)} arguments, got {len(args)}")
+
+        out = bytearray([code])
+        for field, token in zip(layout, args):
+            if field == "o":
+                out += self.operand(token)
+            elif field == "c":
+                if not token.startswith("$") and not COORD_MIN <= int(token, 0) <= COORD_MAX:
+                    raise SceneError(f"{token} is outside {COORD_MIN}..{COORD_MAX}")
+                out += self.operand(token)
+            elif field == "f":
+                out += self.name(FONTS, token, "font")
+            elif field == "t":
+                text = token.encode("ascii")
+                if len(text) > 255:
+                    raise SceneError("text longer than 255 characters")
+                out += bytes([len(text)]) + text
+            elif field == "s":
+                out += self.name(SPRITES, token, "sprite")
+            elif field == "b":
+                out += self.name(BLENDS, token, "blend")
+            elif field == "p":
+                out += self.name(FACE_PARAMS, token, "face parameter")
+            elif field == "v":
+                out += bytes([self.variable(token)])
+            elif field == "e":
+                out += self.name(EASES, token, "ease")
+
+        if op == "loop":
+            self.depth += 1
+            if self.depth > MAX_LOOP_DEPTH:
+                raise SceneError(f"loops nested deeper than {MAX_LOOP_DEPTH}")
+        elif op == "next":
+            if self.depth == 0:
+                raise SceneError("next without loop")
+            self.depth -= 1
+        self.code += out
+
+    def compile(self, source):
+        for number, line in enumerate(source.splitlines(), 1):
+            try:
+                words = shlex.split(line, comments=True)
+                if words:
+                    self.instruction(words)
+            except (SceneError, ValueError) as e:
+                raise SceneError(f"line {number}: {e}") from None
+        if self.depth:
+            raise SceneError("loop without next")
+        if not self.code:
+            raise SceneError("empty scene")
+
+        blob = struct.pack(HEADER_FORMAT, SCENE_MAGIC, SCENE_VERSION, len(self.variables), len(self.code))
+        blob += self.code
+        if len(blob) > MAX_BYTES:
+            raise SceneError(f"scene is {len(blob)} bytes, the device takes {MAX_BYTES}")
+        return bytes(blob)
+
+
+def compile_scene(source):
+    return Compiler().compile(source)
+
+
+def upload_scene(blob, host):
+    """Send the scene to a device, which starts playing it"""
+    request = urllib.request.Request(f"http://{host}/api/scene", data=blob, method="POST",
+                                     headers={"Content-Type": "application/octet-stream"})
+    try:
+        with urllib.request.urlopen(request, timeout=10) as response:
+            result = json.loads(response.read())
+    except urllib.error.HTTPError as e:
+        result = json.loads(e.read() or b"{}")
+    except (urllib.error.URLError, OSError) as e:
+        result = {"error": str(e)}
+
+    if not result.get("success"):
+        print(f"❌ Upload failed: {result.get('error', 'unknown error')}")
+        return False
+    print(f"✅ Scene playing on {host}")
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compile a Tabbie scene script to bytecode")
+    parser.add_argument("scene", help="scene script")
+    parser.add_argument("--out", help="write the compiled scene here")
+    parser.add_argument("--upload", metavar="HOST", help="send the scene to a device (tabbie.local or its IP)")
+    args = parser.parse_args()
+
+    try:
+        blob = compile_scene(Path(args.scene).read_text(encoding="utf-8"))
+    except SceneError as e:
+        sys.stderr.write(f"❌ {args.scene}: {e}\n")
+        return 1
+    print(f"🎬 {args.scene}: {len(blob)} bytes")
+
+    if args.out:
+        Path(args.out).write_bytes(blob)
+        print(f"✅ Wrote {args.out}")
+    if args.upload and not upload_scene(blob, args.upload):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())